@@ -0,0 +1,177 @@
+#ifndef _ADC_HPP__
+#define _ADC_HPP__
+
+// Sensor acquisition.  The ADC runs free over several channels and DMA keeps a ring of samples
+// topped up, there is no interrupt per sample or per block.  Whoever wants the values calls poll(),
+// normally once per control tick, which runs everything new through a CIC decimator per channel.
+
+#include "hal.hpp"
+#include "seqlock.hpp"
+
+#include <array>
+
+
+// Cascaded integrator comb.  ORDER integrators at the input rate, decimate by RATIO, ORDER combs at
+// the output rate.  ORDER 1 is a plain boxcar average.  The registers are allowed to wrap: the
+// combs take differences, so the output is right as long as it fits in 32 bits.
+// Outputs are ADC counts with FRACTION_BITS below the point, and the first ORDER of them are still
+// filling up.
+template <uint ORDER, uint RATIO>
+class CicDecimator {
+
+	static_assert(ORDER >= 1, "ORDER must be at least 1.");
+	static_assert(RATIO >= 2 && (RATIO & (RATIO - 1)) == 0, "RATIO must be a power of two.");
+
+	static constexpr uint log2(uint n) { return n > 1 ? 1 + log2(n / 2) : 0; }
+
+public:
+	static constexpr uint GAIN_BITS { ORDER * log2(RATIO) };
+	static constexpr uint FRACTION_BITS { GAIN_BITS < 4 ? GAIN_BITS : 4 };
+	static_assert(12 + GAIN_BITS <= 32, "The output would overflow the registers.");
+
+private:
+	std::array<uint32_t, ORDER> integrators;
+	std::array<uint32_t, ORDER> combs;		// Last input to each comb.
+	uint phase;
+	uint32_t output;
+
+public:
+	CicDecimator() : integrators(), combs(), phase(0), output(0) {}
+
+	// True when this sample finished an output.
+	bool push(uint16_t sample) {
+
+		uint32_t x = sample;
+		for (auto& integrator : integrators) x = integrator += x;
+		if (++phase < RATIO) return false;
+
+		phase = 0;
+		for (auto& comb : combs) {
+			uint32_t y = x - comb;
+			comb = x;
+			x = y;
+		}
+		output = x >> (GAIN_BITS - FRACTION_BITS);
+		return true;
+	}
+
+	uint32_t value() const { return output; }
+};
+
+
+
+// Captures up to HAL::ADC_CHANNELS channels into a ring of RING_SAMPLES and decimates each one.
+// Lives on one core: start(), poll() and value() all from the same one.  Only the stats are for
+// anyone.
+template <size_t RING_SAMPLES, uint ORDER, uint RATIO>
+class AdcCapture {
+
+public:
+	using Decimator = CicDecimator<ORDER, RATIO>;
+	static constexpr uint FRACTION_BITS { Decimator::FRACTION_BITS };
+
+	// busyUs is the time spent in poll(), samples / elapsed is the rate it kept up with.
+	struct Stats {
+		uint64_t samples;
+		uint32_t outputs;		// Per channel.
+		uint32_t overruns;		// Polls that came too late, the ring had gone round.
+		uint64_t busyUs;
+		uint64_t elapsedUs;
+	};
+
+private:
+	std::array<uint16_t, RING_SAMPLES> ring;
+	std::array<Decimator, HAL::ADC_CHANNELS> decimators;	// By position in the round robin.
+	std::array<uint8_t, HAL::ADC_CHANNELS> positions;		// Channel to position.
+	uint channels;
+	size_t ringSamples;		// A whole number of rounds.
+	size_t next;
+	uint position;			// Of ring[next].
+	uint64_t ringUs;
+	uint64_t startUs;
+	uint64_t lastPollUs;
+	Stats stats;
+	SeqLock<Stats> published;
+
+	// sampleRateHz is for all the channels together.
+	bool begin(uint32_t channelMask, uint32_t sampleRateHz) {
+
+		channels = 0;
+		for (uint channel = 0; channel < HAL::ADC_CHANNELS; ++channel) {
+			if (channelMask & (1u << channel)) positions[channel] = channels++;
+		}
+		if (!channels || sampleRateHz < channels) return false;
+
+		decimators = {};
+		ringSamples = RING_SAMPLES / channels * channels;
+		next = 0;
+		position = 0;
+		stats = {};
+		ringUs = ringSamples * 1'000'000ull / sampleRateHz;
+		startUs = lastPollUs = HAL::timeUs();
+		return true;
+	}
+
+public:
+	AdcCapture() : ring(), decimators(), positions(), channels(0), ringSamples(0), next(0), position(0),
+				   ringUs(0), startUs(0), lastPollUs(0), stats(), published() {}
+
+	// Free running, each channel in channelMask gives outputRateHz values a second.
+	void start(uint32_t channelMask, uint outputRateHz) {
+
+		channelMask &= (1u << HAL::ADC_CHANNELS) - 1;
+		uint32_t sampleRateHz = outputRateHz * RATIO * __builtin_popcount(channelMask);
+		if (!begin(channelMask, sampleRateHz)) return;
+		HAL::adcStartCapture(channelMask, sampleRateHz, ring.data(), ringSamples);
+	}
+
+	// One conversion every wraps wraps of the PWM slice, wrapping wrapHz times a second, so every
+	// sample is taken at the same point of the switching cycle.  The channels take turns, each
+	// gives wrapHz / (wraps * channels * RATIO) values a second.
+	void startOnPwm(uint32_t channelMask, uint slice, uint wraps, uint32_t wrapHz) {
+
+		channelMask &= (1u << HAL::ADC_CHANNELS) - 1;
+		if (!begin(channelMask, wrapHz / wraps)) return;
+		HAL::adcStartCaptureOnPwmWrap(channelMask, slice, wraps, ring.data(), ringSamples);
+	}
+
+	void stop() {
+		HAL::adcStopCapture();
+		channels = 0;
+	}
+
+	// Runs whatever the DMA has written since last time through the decimators.  Returns how many
+	// new values that made for each channel.
+	uint poll() {
+
+		if (!channels) return 0;
+		auto nowUs = HAL::timeUs();
+		if (nowUs - lastPollUs >= ringUs) ++stats.overruns;
+		lastPollUs = nowUs;
+
+		uint outputs = 0;
+		size_t end = HAL::adcCaptureIndex();
+		stats.samples += end >= next ? end - next : end + ringSamples - next;
+		while (next != end) {
+			// All the channels finish on the same round, count the last.
+			if (decimators[position].push(ring[next]) && position == channels - 1) ++outputs;
+			if (++position == channels) position = 0;
+			if (++next == ringSamples) next = 0;
+		}
+
+		stats.outputs += outputs;
+		stats.busyUs += HAL::timeUs() - nowUs;
+		stats.elapsedUs = nowUs - startUs;
+		published.write(stats);
+		return outputs;
+	}
+
+	// Latest output for the channel, ADC counts << FRACTION_BITS.
+	uint32_t value(uint channel) const { return decimators[positions[channel % HAL::ADC_CHANNELS]].value(); }
+	// Past the filter's start up.
+	bool ready() const { return channels && stats.outputs >= ORDER; }
+
+	Stats getStats() const { return published.read(); }	// From either core.
+};
+
+#endif // _ADC_HPP__
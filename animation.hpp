@@ -0,0 +1,234 @@
+#ifndef _ANIMATION_HPP__
+#define _ANIMATION_HPP__
+
+// Keyframe animations of single rows, drawn into the display's back buffer from a timer tick.
+//
+// Starting one only fills in a slot, nothing is drawn or waited for until tick(), which draws the
+// frame each animation is on by now and says when the next one is due.  Frames follow the clock,
+// not the ticks, so a late or extra tick skips or repeats nothing.  Starting an animation on a row
+// replaces any already there.
+//
+// The text isn't copied.  It has to stay put while the animation runs, like a menu item's content.
+
+#include "hal.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+
+template <typename Display>
+class Animator {
+
+public:
+	enum class Kind : uint8_t { Blink, Invert, Marquee, Progress };
+
+	using Permille = uint (*)();		// How far along a progress bar is, 0 to 1000.
+
+	static constexpr uint MAX_ANIMATIONS { 4 };
+	static constexpr uint64_t IDLE { UINT64_MAX };
+	static constexpr uint MAX_COLUMNS { 21 };		// A marquee's window, as wide as a menu line.
+	static constexpr uint MARQUEE_GAP { 3 };		// Spaces between the end of the text and its start again.
+
+private:
+	struct Animation {
+		bool active;
+		Kind kind;
+		bool endInverted;		// How the row is left, or for a marquee how it's drawn.
+		int row;
+		int font;
+		uint pages;				// The bar's height.
+		const char* text;
+		Permille permille;
+		uint columns;			// The marquee's window.
+		uint frames;			// 0 runs until it's stopped.
+		uint32_t frameUs;
+		uint64_t startUs;
+		uint drawn;				// The frame on the row now, + 1.  0 for none yet.
+	};
+
+	Display& display;
+	const uint widthPixels;
+	std::array<Animation, MAX_ANIMATIONS> animations;
+
+	int start(const Animation& animation);
+	void drawFrame(const Animation& animation, uint frame);
+	void drawEnd(const Animation& animation);
+
+public:
+	Animator(Display& display, uint widthPixels) : display(display), widthPixels(widthPixels), animations() {}
+
+	// Each returns a slot for stop(), or -1 if they're all taken, when the row is just left as it ends.
+	// Alternates the row with times frames, the last one as it's left.
+	int blink(int row, const char* text, int font, uint times, uint32_t frameUs, bool endInverted, uint64_t nowUs);
+	// Inverted for holdUs, then back.
+	int invert(int row, const char* text, int font, uint32_t holdUs, bool endInverted, uint64_t nowUs);
+	// Scrolls text too long for columns through them a character a step, until it's stopped.
+	int marquee(int row, const char* text, int font, uint columns, uint32_t stepUs, bool inverted, uint64_t nowUs);
+	// A bar across pages rows from row, redrawn every frameUs as permille changes until it's full.
+	int progress(int row, uint pages, Permille permille, uint32_t frameUs, uint64_t nowUs);
+
+	// Where they are.  Nothing is redrawn, whatever stopped them draws over it.
+	void stop(int slot);
+	void stopRow(int row);
+	void stopAll();
+
+	// Draws what's due and flushes once.  Returns when the next frame is due, or IDLE.
+	uint64_t tick(uint64_t nowUs);
+	bool active() const;
+};
+
+
+
+template <typename Display>
+int Animator<Display>::start(const Animation& animation) {
+
+	stopRow(animation.row);
+	for (uint slot = 0; slot < MAX_ANIMATIONS; ++slot) {
+		if (animations[slot].active) continue;
+		animations[slot] = animation;
+		return slot;
+	}
+	drawEnd(animation);
+	display.flush();
+	return -1;
+}
+
+
+template <typename Display>
+int Animator<Display>::blink(int row, const char* text, int font, uint times, uint32_t frameUs, bool endInverted, uint64_t nowUs) {
+	return start(Animation { true, Kind::Blink, endInverted, row, font, 0, text, nullptr, 0, times, frameUs, nowUs, 0 });
+}
+
+
+template <typename Display>
+int Animator<Display>::invert(int row, const char* text, int font, uint32_t holdUs, bool endInverted, uint64_t nowUs) {
+	return start(Animation { true, Kind::Invert, endInverted, row, font, 0, text, nullptr, 0, 1, holdUs, nowUs, 0 });
+}
+
+
+template <typename Display>
+int Animator<Display>::marquee(int row, const char* text, int font, uint columns, uint32_t stepUs, bool inverted, uint64_t nowUs) {
+	columns = std::min(columns, MAX_COLUMNS);
+	return start(Animation { true, Kind::Marquee, inverted, row, font, 0, text, nullptr, columns, 0, stepUs, nowUs, 0 });
+}
+
+
+template <typename Display>
+int Animator<Display>::progress(int row, uint pages, Permille permille, uint32_t frameUs, uint64_t nowUs) {
+	return start(Animation { true, Kind::Progress, false, row, 0, pages, nullptr, permille, 0, 0, frameUs, nowUs, 0 });
+}
+
+
+template <typename Display>
+void Animator<Display>::stop(int slot) {
+	if (slot >= 0 && slot < static_cast<int>(MAX_ANIMATIONS)) animations[slot].active = false;
+}
+
+
+template <typename Display>
+void Animator<Display>::stopRow(int row) {
+	for (auto& animation : animations) {
+		if (animation.row == row) animation.active = false;
+	}
+}
+
+
+template <typename Display>
+void Animator<Display>::stopAll() {
+	for (auto& animation : animations) animation.active = false;
+}
+
+
+template <typename Display>
+void Animator<Display>::drawFrame(const Animation& animation, uint frame) {
+
+	switch (animation.kind) {
+		case Kind::Blink:		// Counted back from the last frame so that it's the end state.
+			display.drawLine(animation.text, animation.row, ((animation.frames - 1 - frame) % 2 == 0) == animation.endInverted, animation.font);
+			break;
+		case Kind::Invert:
+			display.drawLine(animation.text, animation.row, !animation.endInverted, animation.font);
+			break;
+		case Kind::Marquee: {
+			char window[MAX_COLUMNS + 1];
+			uint length = std::strlen(animation.text);
+			uint cycle = length + MARQUEE_GAP;
+			for (uint i = 0; i < animation.columns; ++i) {
+				uint at = (frame + i) % cycle;
+				window[i] = at < length ? animation.text[at] : ' ';
+			}
+			window[animation.columns] = '\0';
+			display.drawLine(window, animation.row, animation.endInverted, animation.font);
+			break;
+		}
+		case Kind::Progress: {
+			int top = animation.row * 8;
+			int bottom = (animation.row + static_cast<int>(animation.pages)) * 8 - 1;
+			int right = widthPixels - 1;
+			int filled = std::min(animation.permille(), 1000u) * (right - 1) / 1000;
+			display.drawRectangle(0, top, right, bottom, 255, false);
+			if (filled > 0) display.drawRectangle(1, top + 1, filled, bottom - 1, 255, true);
+			if (filled < right - 1) display.drawRectangle(filled + 1, top + 1, right - 1, bottom - 1, 0, true);
+			break;
+		}
+	}
+}
+
+
+template <typename Display>
+void Animator<Display>::drawEnd(const Animation& animation) {
+
+	switch (animation.kind) {
+		case Kind::Blink:
+		case Kind::Invert:
+			display.drawLine(animation.text, animation.row, animation.endInverted, animation.font);
+			break;
+		case Kind::Marquee:
+		case Kind::Progress:
+			drawFrame(animation, 0);
+			break;
+	}
+}
+
+
+template <typename Display>
+uint64_t Animator<Display>::tick(uint64_t nowUs) {
+
+	uint64_t next = IDLE;
+	bool drew = false;
+	for (auto& animation : animations) {
+		if (!animation.active) continue;
+
+		uint frame = nowUs > animation.startUs ? (nowUs - animation.startUs) / animation.frameUs : 0;
+		if (animation.frames && frame >= animation.frames) {
+			drawEnd(animation);
+			animation.active = false;
+			drew = true;
+			continue;
+		}
+		if (animation.kind == Kind::Progress) {
+			drawFrame(animation, frame);		// For the bar the frame is just when to look again.
+			drew = true;
+			if (animation.permille() >= 1000) {
+				animation.active = false;
+				continue;
+			}
+		} else if (animation.drawn != frame + 1) {
+			drawFrame(animation, frame);
+			animation.drawn = frame + 1;
+			drew = true;
+		}
+		next = std::min(next, animation.startUs + static_cast<uint64_t>(frame + 1) * animation.frameUs);
+	}
+	if (drew) display.flush();
+	return next;
+}
+
+
+template <typename Display>
+bool Animator<Display>::active() const {
+	return std::any_of(animations.begin(), animations.end(), [](const Animation& animation){ return animation.active; });
+}
+
+#endif // _ANIMATION_HPP__
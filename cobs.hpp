@@ -0,0 +1,58 @@
+#ifndef _COBS_HPP__
+#define _COBS_HPP__
+
+// Consistent overhead byte stuffing.  Encoded data has no zero bytes, so a zero can end each frame
+// and a receiver that starts mid stream, or loses bytes, is back in step at the next zero.  The
+// overhead is one byte, plus one per 254 bytes of data.
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace COBS {
+
+	constexpr size_t maxEncoded(size_t bytes) { return bytes + bytes / 254 + 1; }
+
+	// Encodes bytes of data into out, anything indexable from 0 so it can be a ring.  No delimiter.
+	// Returns the encoded length.
+	template <typename Out>
+	size_t encode(const uint8_t* data, size_t bytes, Out&& out) {
+
+		size_t code = 0;		// Where the current block's length goes.
+		size_t at = 1;
+		uint8_t run = 1;
+		for (size_t i = 0; i < bytes; ++i) {
+			if (data[i]) {
+				out[at++] = data[i];
+				++run;
+			}
+			if (!data[i] || run == 0xFF) {
+				out[code] = run;
+				code = at++;
+				run = 1;
+			}
+		}
+		out[code] = run;
+		return at;
+	}
+
+	// Decodes one frame, without its delimiter, into out, which needs room for bytes.  Returns the
+	// decoded length, or 0 if it wasn't valid COBS.
+	inline size_t decode(const uint8_t* in, size_t bytes, uint8_t* out) {
+
+		size_t n = 0;
+		size_t i = 0;
+		while (i < bytes) {
+			uint8_t code = in[i++];
+			if (!code || i + code - 1 > bytes) return 0;
+			for (uint8_t k = 1; k < code; ++k) {
+				if (!in[i]) return 0;
+				out[n++] = in[i++];
+			}
+			if (code != 0xFF && i < bytes) out[n++] = 0;
+		}
+		return n;
+	}
+}
+
+#endif // _COBS_HPP__
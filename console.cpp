@@ -0,0 +1,234 @@
+#include "console.hpp"
+
+#include <cstring>
+
+
+namespace {
+
+	char upper(char c) { return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c; }
+	bool isShort(char c) { return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '*'; }
+	char* skipSpaces(char* c) {
+		while (*c == ' ' || *c == '\t') ++c;
+		return c;
+	}
+	void trimEnd(char* start, char* end) {
+		while (end > start && (end[-1] == ' ' || end[-1] == '\t')) *--end = '\0';
+	}
+
+	// Past this many digits a number can't fit a Number once it is scaled by ONE.
+	constexpr int64_t MANTISSA_LIMIT { 100'000'000'000 };
+	constexpr uint MAX_DECIMALS { 9 };
+}
+
+
+// Reply
+
+void Console::Reply::append(const char* text, uint bytes) {
+
+	if (failed) return;
+	if (length + bytes >= buffer.size()) {
+		error("reply too long");
+		return;
+	}
+	std::memcpy(&buffer[length], text, bytes);
+	truncate(length + bytes);
+}
+
+
+void Console::Reply::add(const char* text) { append(text, std::strlen(text)); }
+
+
+void Console::Reply::addScaled(int64_t scaled, uint8_t decimals) {
+
+	char text[24];
+	uint used = Format::rightAlignedScaled(text, sizeof(text), scaled, false, decimals);
+	append(text + sizeof(text) - used, used);
+}
+
+
+void Console::Reply::error(const char* reason) {
+
+	failed = false;
+	truncate(0);
+	add("ERR ");
+	add(reason);
+	failed = true;
+}
+
+
+// Args
+
+bool Console::Args::number(uint i, Number& out) const {
+
+	if (i >= count) return false;
+	const char* c = words[i];
+	bool negative = *c == '-';
+	if (*c == '-' || *c == '+') ++c;
+
+	int64_t mantissa = 0;
+	int64_t scale = 1;
+	bool point = false;
+	bool digits = false;
+	for (; *c; ++c) {
+		if (*c == '.' && !point) {
+			point = true;
+			continue;
+		}
+		if (*c < '0' || *c > '9') return false;
+		digits = true;
+		if (point && scale == Format::POWERS_OF_TEN[MAX_DECIMALS]) continue;		// Beyond what a Number holds anyway.
+		if (mantissa >= MANTISSA_LIMIT) {
+			if (!point) return false;
+			continue;
+		}
+		mantissa = mantissa * 10 + (*c - '0');
+		if (point) scale *= 10;
+	}
+	if (!digits) return false;
+	out = Number::ratio(negative ? -mantissa : mantissa, scale);
+	return true;
+}
+
+
+// Console
+
+Console::Console(const Command* commands, uint count) :
+			commands(commands),
+			count(count),
+			line(),
+			length(0),
+			overlong(false),
+			reply(),
+			stats() {}
+
+
+// Node by node, each the whole of the pattern's node or just its capitals.
+bool Console::matches(const char* pattern, const char* header) {
+
+	while (*pattern) {
+		uint full = 0;
+		uint brief = 0;
+		while (pattern[full] && pattern[full] != ':') {
+			if (full == brief && isShort(pattern[full])) ++brief;
+			++full;
+		}
+		uint given = 0;
+		while (header[given] && header[given] != ':') ++given;
+		if (given != full && given != brief) return false;
+		for (uint i = 0; i < given; ++i) {
+			if (upper(header[i]) != upper(pattern[i])) return false;
+		}
+
+		pattern += full;
+		header += given;
+		if (*pattern != *header) return false;		// One has more nodes.
+		if (*pattern) {
+			++pattern;
+			++header;
+		}
+	}
+	return !*header;
+}
+
+
+void Console::run(char* text) {
+
+	++stats.commands;
+	char* c = skipSpaces(text);
+	if (*c == ':') ++c;
+	char* header = c;
+	while (*c && *c != ' ' && *c != '\t' && *c != '?') ++c;
+	bool query = *c == '?';
+	if (*c) *c++ = '\0';
+
+	Args args {};
+	c = skipSpaces(c);
+	while (*c) {
+		if (args.count == MAX_ARGS) {
+			reply.error("too many arguments");
+			return;
+		}
+		char* word = c;
+		char* end = c;
+		while (*end && *end != ',') ++end;
+		c = *end ? end + 1 : end;
+		*end = '\0';
+		trimEnd(word, end);
+		args.words[args.count++] = word;
+		c = skipSpaces(c);
+	}
+
+	for (uint i = 0; i < count; ++i) {
+		if (!matches(commands[i].header, header)) continue;
+		auto handler = query ? commands[i].query : commands[i].set;
+		if (!handler) {
+			reply.error(query ? "no query form" : "query only");
+			return;
+		}
+		handler(args, reply);
+		return;
+	}
+	reply.error("undefined header");
+}
+
+
+const Console::Reply& Console::execute(char* text) {
+
+	++stats.lines;
+	reply.clear();
+	while (text) {
+		char* next = std::strchr(text, ';');
+		if (next) *next++ = '\0';
+		if (*skipSpaces(text)) {
+			uint before = reply.size();
+			if (before) reply.add(";");
+			run(text);
+			if (reply.hasFailed()) {
+				++stats.errors;
+				break;
+			}
+			if (before && reply.size() == before + 1) reply.truncate(before);		// Nothing to say.
+		}
+		text = next;
+	}
+	return reply;
+}
+
+
+void Console::respond() {
+
+	if (!reply.size()) return;
+	HAL::consoleWrite(reply.text(), reply.size());
+	HAL::consoleWrite("\n", 1);
+}
+
+
+bool Console::service() {
+
+	for (uint i = 0; i < MAX_CHARS_PER_SERVICE; ++i) {
+		int c = HAL::consoleRead();
+		if (c < 0) return false;
+		if (c == '\r' || c == '\n') {
+			if (overlong) {
+				overlong = false;
+				length = 0;
+				++stats.lines;
+				++stats.errors;
+				reply.clear();
+				reply.error("line too long");
+				respond();
+				return true;
+			}
+			if (!length) continue;		// The other half of a CR LF, or a blank line.
+			line[length] = '\0';
+			length = 0;
+			execute(line.data());
+			respond();
+			return true;
+		}
+		if (overlong) continue;
+		if (length == MAX_LINE) overlong = true;
+		else line[length++] = static_cast<char>(c);
+	}
+	return true;
+}
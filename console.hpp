@@ -0,0 +1,114 @@
+#ifndef _CONSOLE_HPP__
+#define _CONSOLE_HPP__
+
+// Line oriented commands on the stdio UART, SCPI style:
+//
+//   TEMPerature:SETpoint 25.0        PID:KP?        *IDN?        PID:KP 0.8;PID:KI?
+//
+// A header is nodes separated by ':', each matching its long or short form, the capitals, in any
+// case.  A '?' straight after it makes it a query, anything after a space is arguments separated by
+// ','.  ';' separates commands on a line, each with its full header, and the replies to the line
+// come back on one line separated by ';'.  A command that fails replies "ERR <reason>" and the rest
+// of the line is skipped.  Commands that set something say nothing when they work.
+//
+// The line is tokenised where it lies, in a fixed buffer, and commands come from a static table,
+// so nothing is allocated.  service() takes at most MAX_CHARS_PER_SERVICE characters and runs at
+// most one line each call, so a pass of the main loop stays short however fast the host sends.
+
+#include "hal.hpp"
+#include "fixed.hpp"
+#include "format.hpp"
+
+#include <array>
+
+
+class Console {
+
+public:
+	static constexpr uint MAX_LINE { 96 };
+	static constexpr uint MAX_REPLY { 96 };
+	static constexpr uint MAX_ARGS { 4 };
+	static constexpr uint MAX_CHARS_PER_SERVICE { 32 };
+
+	using Number = Fixed<15, 16>;
+
+	class Reply {
+		std::array<char, MAX_REPLY> buffer;
+		uint length;
+		bool failed;
+
+	public:
+		Reply() : buffer(), length(0), failed(false) {}
+
+		void add(const char* text);
+		void add(int64_t value) { addScaled(value, 0); }
+		void addScaled(int64_t scaled, uint8_t decimals);		// scaled / 10^decimals.
+		template <typename T>
+		void add(T value, uint8_t decimals) {
+			char text[24];
+			uint used = Format::rightAligned(text, sizeof(text), value, false, decimals);
+			append(text + sizeof(text) - used, used);
+		}
+		void error(const char* reason);		// Replaces anything else.
+
+		bool hasFailed() const { return failed; }
+		const char* text() const { return buffer.data(); }
+		uint size() const { return length; }
+
+	private:
+		friend class Console;
+		void append(const char* text, uint bytes);
+		void clear() { truncate(0); failed = false; }
+		void truncate(uint to) { buffer[length = to] = '\0'; }
+	};
+
+	struct Args {
+		uint count;
+		const char* words[MAX_ARGS];
+
+		// The whole argument as a Number: an optional sign, digits and up to 9 decimals.
+		bool number(uint i, Number& out) const;
+	};
+
+	using Handler = void (*)(const Args& args, Reply& reply);
+
+	// Either handler can be nullptr if there is no such form.
+	struct Command {
+		const char* header;		// "TEMPerature:SETpoint"
+		Handler set;
+		Handler query;
+	};
+
+	struct Stats {
+		uint32_t lines;
+		uint32_t commands;
+		uint32_t errors;
+	};
+
+private:
+	const Command* const commands;
+	const uint count;
+	std::array<char, MAX_LINE + 1> line;
+	uint length;
+	bool overlong;		// Skipping to the end of a line that didn't fit.
+	Reply reply;
+	Stats stats;
+
+	static bool matches(const char* pattern, const char* header);
+	void run(char* text);
+	void respond();
+
+public:
+	template <size_t N>
+	Console(const Command (&commands)[N]) : Console(commands, N) {}
+	Console(const Command* commands, uint count);
+
+	bool service();		// From the main loop.  True if there may be more waiting.
+
+	// Runs a line, without its end, in place.  The reply is empty if there is nothing to say.
+	const Reply& execute(char* text);
+
+	const Stats& getStats() const { return stats; }
+};
+
+#endif // _CONSOLE_HPP__
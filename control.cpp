@@ -0,0 +1,339 @@
+#include "control.hpp"
+
+#include <algorithm>
+
+
+namespace {
+
+	// Gains are Q16 full scale per degree, the loop wants Q15 output per milli degree.
+	constexpr int64_t PER_MILLI_C_NUM { PID::OUTPUT_MAX };
+	constexpr int64_t PER_MILLI_C_DEN { 1000 };
+
+	// Rounded, and saturated to what fits the loop's int32_t.
+	constexpr int32_t toLoop(int64_t numerator, int64_t denominator) {
+		int64_t q = (numerator + denominator / 2) / denominator;
+		return static_cast<int32_t>(std::clamp<int64_t>(q, INT32_MIN, INT32_MAX));
+	}
+
+	// Rounded down.
+	uint32_t isqrt(uint64_t value) {
+
+		uint64_t root = 0;
+		for (uint64_t bit = uint64_t(1) << 62; bit; bit >>= 2) {
+			if (value >= root + bit) {
+				value -= root + bit;
+				root = (root >> 1) + bit;
+			} else {
+				root >>= 1;
+			}
+		}
+		return static_cast<uint32_t>(root);
+	}
+
+	bool agree(int64_t a, int64_t b) { return std::abs(a - b) * RelayTuner::AGREEMENT <= std::max(a, b); }
+
+	// Tyreus-Luyben PI: kp Ku / 3.2, Ti 2.2 Tu.
+	constexpr PID::Gain TL_KP { 1 / 3.2 };
+	constexpr PID::Gain TL_KI { 1 / (3.2 * 2.2) };
+}
+
+
+
+
+// PID
+
+PID::PID() : kp(0), ki(0), kd(0), dAlpha(0), integral(0), derivative(0), lastMeasurement(0), primed(false), outMin(-OUTPUT_MAX), outMax(OUTPUT_MAX) {}
+
+
+void PID::configure(const Gains& gains, uint rateHz) {
+
+	// Integers throughout.  The gains are Q16 like the loop's, so only ki needs shifting, and only
+	// by 8, which keeps even a saturated gain inside 64 bits.
+	static_assert(Gain::FRAC_BITS == GAIN_SHIFT && KI_SHIFT >= GAIN_SHIFT);
+	static_assert(Gain(GAIN_MAX).raw() * PER_MILLI_C_NUM / PER_MILLI_C_DEN <= INT32_MAX);
+	int64_t kpRaw = std::max(gains.kp, Gain(0)).raw();
+	int64_t kiRaw = std::max(gains.ki, Gain(0)).raw();
+	int64_t kdRaw = std::max(gains.kd, Gain(0)).raw();
+	int64_t filterRaw = std::max(gains.dFilterS, Gain(0)).raw();
+
+	kp = toLoop(kpRaw * PER_MILLI_C_NUM, PER_MILLI_C_DEN);
+	ki = toLoop((kiRaw * PER_MILLI_C_NUM) << (KI_SHIFT - GAIN_SHIFT), PER_MILLI_C_DEN * rateHz);
+	kd = toLoop(kdRaw * PER_MILLI_C_NUM * rateHz, PER_MILLI_C_DEN);
+	// ts / (filter + ts) = 1 / (filter * rate + 1), in Q16.
+	dAlpha = toLoop(int64_t(Gain::ONE) << 16, filterRaw * rateHz + Gain::ONE);
+}
+
+
+void PID::setLimits(int32_t min, int32_t max) {
+
+	outMin = std::max(min, -OUTPUT_MAX);
+	outMax = std::min(max, OUTPUT_MAX);
+	integral = std::clamp(integral, static_cast<int64_t>(outMin) << KI_SHIFT, static_cast<int64_t>(outMax) << KI_SHIFT);
+}
+
+
+void PID::reset(int32_t output) {
+
+	integral = static_cast<int64_t>(std::clamp(output, outMin, outMax)) << KI_SHIFT;
+	derivative = 0;
+	primed = false;
+}
+
+
+int32_t PID::update(int32_t setpoint, int32_t measurement) {
+
+	int32_t error = setpoint - measurement;
+	if (!primed) {
+		lastMeasurement = measurement;
+		primed = true;
+	}
+
+	int64_t p = (static_cast<int64_t>(kp) * error) >> GAIN_SHIFT;
+	int32_t rawD = static_cast<int32_t>(std::clamp<int64_t>(-(static_cast<int64_t>(kd) * (measurement - lastMeasurement)) >> GAIN_SHIFT, -OUTPUT_MAX, OUTPUT_MAX));
+	lastMeasurement = measurement;
+	derivative += static_cast<int32_t>((static_cast<int64_t>(rawD - derivative) * dAlpha) >> 16);
+
+	int64_t sum = p + (integral >> KI_SHIFT) + derivative;
+	int32_t out = static_cast<int32_t>(std::clamp<int64_t>(sum, outMin, outMax));
+
+	bool pinned = (sum >= outMax && error > 0) || (sum <= outMin && error < 0);
+	if (!pinned) {
+		integral = std::clamp(integral + static_cast<int64_t>(ki) * error, static_cast<int64_t>(outMin) << KI_SHIFT, static_cast<int64_t>(outMax) << KI_SHIFT);
+	}
+	return out;
+}
+
+
+
+
+// RelayTuner
+
+RelayTuner::RelayTuner() : config(), rateHz(0), setpoint(0), bias(0), heating(true), ticks(0), cycleStart(0), high(0), low(0), lastPeriod(0), lastSwing(0), result() {}
+
+
+void RelayTuner::begin(const Config& config, uint rateHz, int32_t setpoint, int32_t bias, PID::Gain dFilterS) {
+
+	this->config = config;
+	this->rateHz = rateHz;
+	this->setpoint = setpoint;
+	this->bias = bias;
+	heating = true;
+	ticks = 0;
+	cycleStart = 0;
+	lastPeriod = 0;
+	lastSwing = 0;
+	result = Result { State::Running, 0, 0, 0, { 0, 0, 0, dFilterS } };
+}
+
+
+int32_t RelayTuner::update(int32_t measurement) {
+
+	if (!running()) return bias;
+	++ticks;		// From 1, so a cycleStart of 0 means no cycle yet.
+	int32_t error = measurement - setpoint;
+	if (std::abs(error) > config.limit || ticks > config.timeoutS * rateHz) {
+		result.state = State::Failed;
+		return bias;
+	}
+	high = std::max(high, measurement);
+	low = std::min(low, measurement);
+
+	if (heating && error > config.hysteresis) {
+		heating = false;
+	} else if (!heating && error < -config.hysteresis) {
+		heating = true;
+		if (cycleStart) {
+			uint32_t period = ticks - cycleStart;
+			int32_t swing = high - low;
+			++result.cycles;
+			if (result.cycles >= MIN_CYCLES && agree(period, lastPeriod) && agree(swing, lastSwing)) {
+				finish(period, swing);
+				return bias;
+			}
+			if (result.cycles >= config.maxCycles) {
+				result.state = State::Failed;
+				return bias;
+			}
+			lastPeriod = period;
+			lastSwing = swing;
+		}
+		cycleStart = ticks;
+		high = low = measurement;
+	}
+	return std::clamp(bias + (heating ? config.amplitude : -config.amplitude), -PID::OUTPUT_MAX, PID::OUTPUT_MAX);
+}
+
+
+void RelayTuner::finish(uint32_t period, int32_t swing) {
+
+	// The hysteresis makes the relay switch late, which the describing function takes out.
+	int64_t a = swing / 2;
+	int64_t h = config.hysteresis;
+	uint32_t effective = a > h ? isqrt(a * a - h * h) : 0;
+	if (!effective) {
+		result.state = State::Failed;
+		return;
+	}
+
+	// Ku = 4 d / (pi a), d as a fraction of full scale and a in degrees.  pi is 355 / 113.
+	auto ku = PID::Gain::ratio(int64_t(4'000) * 113 * config.amplitude, int64_t(355) * PID::OUTPUT_MAX * effective);
+	auto tu = PID::Gain::ratio(period, rateHz);
+
+	result.ultimateGain = ku;
+	result.ultimatePeriodS = tu;
+	result.gains.kp = ku * TL_KP;
+	result.gains.ki = ku * TL_KI / tu;
+	result.gains.kd = 0;
+	result.state = State::Done;
+}
+
+
+
+
+// ControlLoop
+
+ControlLoop::ControlLoop(PID& pid, const PID::Gains& gains, Sensor sensor, Actuator actuator, Monitor monitor) :
+			pid(pid),
+			tuner(),
+			sensor(sensor),
+			actuator(actuator),
+			monitor(monitor),
+			timer(),
+			periodUs(0),
+			dueUs(0),
+			gainsApplied(0),
+			resetsApplied(0),
+			tuningApplied(0),
+			lastOutput(0),
+			stats(),
+			running(false),
+			staged { 0, gains, 0, 0, {}, 0 },
+			parameters(staged),
+			status() {}
+
+
+bool ControlLoop::start(uint rateHz) {
+
+	if (running) stop();
+	rateHz = std::clamp(rateHz, MIN_RATE_HZ, MAX_RATE_HZ);
+	periodUs = 1'000'000 / rateHz;
+
+	auto p = parameters.read();
+	pid.configure(p.gains, 1'000'000 / periodUs);
+	pid.reset();
+	gainsApplied = p.gainsChanges;
+	resetsApplied = p.statsResets;
+	tuningApplied = p.tuningStarts;
+	lastOutput = 0;
+	stats = Stats {};
+
+	dueUs = HAL::timeUs() + periodUs;
+	// Negative so the ticks keep to a fixed schedule however long each takes.
+	running = HAL::addRepeatingTimerUs(-static_cast<int64_t>(periodUs), tick, this, &timer);
+	return running;
+}
+
+
+void ControlLoop::stop() {
+
+	if (running) HAL::cancelRepeatingTimer(&timer);
+	running = false;
+	actuator(0);
+	status.write(Status { status.read().measurement, 0, stats, tuner.getResult() });
+}
+
+
+void ControlLoop::publish(const Parameters& p) {
+	staged = p;
+	parameters.write(staged);
+}
+
+
+void ControlLoop::setSetpoint(int32_t milliC) {
+
+	if (milliC == staged.setpoint) return;
+	auto p = staged;
+	p.setpoint = milliC;
+	publish(p);
+}
+
+
+void ControlLoop::setGains(const PID::Gains& gains) {
+
+	auto p = staged;
+	p.gains = gains;
+	++p.gainsChanges;
+	publish(p);
+}
+
+
+void ControlLoop::resetStats() {
+
+	auto p = staged;
+	++p.statsResets;
+	publish(p);
+}
+
+
+void ControlLoop::startAutotune(const RelayTuner::Config& config) {
+
+	auto p = staged;
+	p.tuning = config;
+	++p.tuningStarts;
+	publish(p);
+}
+
+
+bool ControlLoop::tick(HAL::RepeatingTimer* t) {
+
+	auto loop = static_cast<ControlLoop*>(t->user_data);
+	auto start = HAL::timeUs();
+
+	auto p = loop->parameters.read();
+	uint rateHz = 1'000'000 / loop->periodUs;
+	if (p.gainsChanges != loop->gainsApplied) {
+		loop->pid.configure(p.gains, rateHz);
+		loop->gainsApplied = p.gainsChanges;
+	}
+	if (p.tuningStarts != loop->tuningApplied) {
+		loop->tuner.begin(p.tuning, rateHz, p.setpoint, loop->lastOutput, p.gains.dFilterS);
+		loop->tuningApplied = p.tuningStarts;
+	}
+	auto& stats = loop->stats;
+	if (p.statsResets != loop->resetsApplied) {
+		stats = Stats {};
+		loop->resetsApplied = p.statsResets;
+	}
+
+	auto measurement = loop->sensor();
+	int32_t output;
+	if (loop->tuner.running()) {
+		output = loop->tuner.update(measurement);
+		// Finished.  The PID's integral and last measurement are from before the experiment, so it
+		// starts again from the relay's bias, and on the gains found without waiting for the user
+		// side to send them across.
+		if (!loop->tuner.running()) {
+			auto& result = loop->tuner.getResult();
+			if (result.state == RelayTuner::State::Done) loop->pid.configure(result.gains, rateHz);
+			loop->pid.reset(loop->tuner.getBias());
+		}
+	} else {
+		output = loop->pid.update(p.setpoint, measurement);
+	}
+	loop->actuator(output);
+	loop->lastOutput = output;
+
+	uint32_t late = start > loop->dueUs ? start - loop->dueUs : 0;
+	uint32_t exec = HAL::timeUs() - start;
+	++stats.ticks;
+	if (late >= loop->periodUs) ++stats.overruns;
+	stats.maxJitterUs = std::max(stats.maxJitterUs, late);
+	stats.totalJitterUs += late;
+	stats.maxExecUs = std::max(stats.maxExecUs, exec);
+	stats.totalExecUs += exec;
+	loop->dueUs += loop->periodUs;
+
+	loop->status.write(Status { measurement, output, stats, loop->tuner.getResult() });
+	if (loop->monitor) loop->monitor(Sample { stats.ticks, start, p.setpoint, measurement, output, late, exec });
+	return true;
+}
@@ -0,0 +1,232 @@
+#ifndef _CONTROL_HPP__
+#define _CONTROL_HPP__
+
+// Temperature control.  PID does the maths in integers only, ControlLoop runs it from a timer at a
+// fixed rate, reading a sensor and writing an actuator given as plain functions.  RelayTuner
+// finds gains for the PID by making the loop oscillate, and runs in its place while it does.
+//
+// Units: temperatures in milli degrees C, the output is a signed duty in Q15 where +32767 is full
+// heating and -32767 full cooling.
+
+#include "hal.hpp"
+#include "seqlock.hpp"
+#include "fixed.hpp"
+
+
+class PID {
+
+public:
+	static constexpr int32_t OUTPUT_MAX { 32767 };
+	static constexpr int32_t GAIN_MAX { 1'000 };		// Any more kp wouldn't fit the loop's scaling.
+
+	// Gains in real units, only converted to the loop's scaling when configured.
+	using Gain = Fixed<15, 16>;
+	struct Gains {
+		Gain kp;			// Full scale output per degree C.
+		Gain ki;			// Per degree C second.
+		Gain kd;			// Per degree C per second.
+		Gain dFilterS;		// Time constant of the derivative filter.
+	};
+
+private:
+	// Scaled to the output per milli degree and per tick.  ki gets more fraction bits because it is
+	// divided by the rate and would lose most of its precision at 10 kHz.
+	static constexpr uint GAIN_SHIFT { 16 };
+	static constexpr uint KI_SHIFT { 24 };
+	int32_t kp;			// Q16.16
+	int32_t ki;			// Q8.24
+	int32_t kd;			// Q16.16
+	int32_t dAlpha;		// Derivative filter coefficient, Q16.
+
+	int64_t integral;	// Q15 output << KI_SHIFT.
+	int32_t derivative;	// Filtered, Q15 output.
+	int32_t lastMeasurement;
+	bool primed;		// lastMeasurement is valid.
+	int32_t outMin;
+	int32_t outMax;
+
+public:
+	PID();
+
+	void configure(const Gains& gains, uint rateHz);
+	void setLimits(int32_t min, int32_t max);
+	// Forgets the past.  The integral starts at output, Q15, for taking over without a bump from
+	// something else that was driving.
+	void reset(int32_t output = 0);
+
+	// One tick.  Derivative is taken on the measurement so a setpoint step doesn't kick.  The
+	// integral stops when the output is pinned in the direction it would push, and is clamped to
+	// the output range, so it doesn't wind up while saturated.
+	int32_t update(int32_t setpoint, int32_t measurement);
+};
+
+
+
+// Relay feedback autotuning, Astrom and Hagglund.  The output is switched between bias + amplitude
+// and bias - amplitude each time the measurement crosses the setpoint, with some hysteresis for
+// the noise, which settles into a limit cycle at the plant's ultimate period.  From the relay's
+// amplitude d and the oscillation's a, the ultimate gain is 4d / (pi sqrt(a^2 - hysteresis^2)).
+// The gains follow from that and the period by Tyreus-Luyben, PI only.  Ziegler-Nichols rings on
+// a plant whose lag is mostly the thermistor's, and derivative only adds the sensor's noise.
+class RelayTuner {
+
+public:
+	struct Config {
+		int32_t amplitude;		// Q15 either side of the output it starts from.
+		int32_t hysteresis;		// Milli degrees C either side of the setpoint.
+		int32_t limit;			// Gives up if the measurement gets this far from the setpoint.
+		uint32_t maxCycles;
+		uint32_t timeoutS;
+	};
+
+	enum class State : uint8_t { Idle, Running, Done, Failed };
+
+	struct Result {
+		State state;
+		uint32_t cycles;			// Whole oscillations so far.
+		PID::Gain ultimateGain;		// Full scale per degree C.
+		PID::Gain ultimatePeriodS;
+		PID::Gains gains;
+	};
+
+	// Consecutive cycles have to agree to 1 / AGREEMENT of their period and amplitude.
+	static constexpr int32_t AGREEMENT { 10 };
+	static constexpr uint32_t MIN_CYCLES { 3 };		// Counted from the first switch to heating.
+
+private:
+	Config config;
+	uint rateHz;
+	int32_t setpoint;
+	int32_t bias;
+	bool heating;				// Which side of the relay.
+	uint32_t ticks;
+	uint32_t cycleStart;		// Tick of the last switch to heating.
+	int32_t high;				// Extremes of the measurement in the cycle so far.
+	int32_t low;
+	uint32_t lastPeriod;		// Ticks.
+	int32_t lastSwing;			// Peak to peak, milli degrees C.
+	Result result;
+
+	void finish(uint32_t period, int32_t swing);
+
+public:
+	RelayTuner();
+
+	// dFilterS is carried over to the gains found, the experiment says nothing about it.
+	void begin(const Config& config, uint rateHz, int32_t setpoint, int32_t bias, PID::Gain dFilterS);
+	bool running() const { return result.state == State::Running; }
+	int32_t getBias() const { return bias; }		// The output it switches around, what held the setpoint.
+
+	// One tick, in place of PID::update().  Once it stops running, done or failed, it only holds the
+	// bias and the PID should take over.
+	int32_t update(int32_t measurement);
+
+	const Result& getResult() const { return result; }
+};
+
+
+
+// The loop runs on whichever core calls start(), from that core's timer.  Everything else is for
+// the other core: the setpoint and gains go across in one SeqLock and the measurement, output and
+// stats come back in another, so neither side ever blocks the other.
+class ControlLoop {
+
+public:
+	using Sensor = int32_t (*)();				// Measurement, milli degrees C.
+	using Actuator = void (*)(int32_t duty);	// Q15.
+
+	// Every tick, for a Monitor on the control core.  Called once the actuator has its output and
+	// the status is published, so it doesn't delay either, but it has to be quick and can't block.
+	struct Sample {
+		uint32_t tick;
+		uint64_t startUs;
+		int32_t setpoint;
+		int32_t measurement;
+		int32_t output;
+		uint32_t lateUs;
+		uint32_t execUs;
+	};
+	using Monitor = void (*)(const Sample& sample);
+
+	static constexpr uint MIN_RATE_HZ { 1'000 };
+	static constexpr uint MAX_RATE_HZ { 10'000 };
+
+	// All times in microseconds.  Jitter is how late a tick started against its fixed schedule.
+	struct Stats {
+		uint32_t ticks;
+		uint32_t overruns;		// Ticks that started a whole period or more late.
+		uint32_t maxJitterUs;
+		uint64_t totalJitterUs;
+		uint32_t maxExecUs;
+		uint64_t totalExecUs;
+	};
+
+	struct Status {
+		int32_t measurement;
+		int32_t output;
+		Stats stats;
+		RelayTuner::Result tuning;	// Of the last autotune.
+	};
+
+private:
+	struct Parameters {
+		int32_t setpoint;
+		PID::Gains gains;
+		uint32_t gainsChanges;		// Counts, so the loop knows to reconfigure.
+		uint32_t statsResets;
+		RelayTuner::Config tuning;
+		uint32_t tuningStarts;
+	};
+
+	PID& pid;
+	RelayTuner tuner;
+	Sensor sensor;
+	Actuator actuator;
+	Monitor monitor;
+
+	// Control side.
+	HAL::RepeatingTimer timer;
+	uint32_t periodUs;
+	uint64_t dueUs;
+	uint32_t gainsApplied;
+	uint32_t resetsApplied;
+	uint32_t tuningApplied;
+	int32_t lastOutput;
+	Stats stats;
+	volatile bool running;
+
+	// User side.
+	Parameters staged;
+
+	SeqLock<Parameters> parameters;		// User side to control side.
+	SeqLock<Status> status;				// Control side to user side.
+
+	static bool tick(HAL::RepeatingTimer* t);
+	void publish(const Parameters& p);
+
+public:
+	ControlLoop(PID& pid, const PID::Gains& gains, Sensor sensor, Actuator actuator, Monitor monitor = nullptr);
+
+	// On the control core.
+	bool start(uint rateHz);	// Clamped to MIN_RATE_HZ - MAX_RATE_HZ.
+	void stop();				// Leaves the actuator at zero.
+
+	// On the user core.
+	bool isRunning() const { return running; }
+	void setSetpoint(int32_t milliC);
+	int32_t getSetpoint() const { return staged.setpoint; }
+	void setGains(const PID::Gains& gains);
+	const PID::Gains& getGains() const { return staged.gains; }
+	void resetStats();
+	// Runs a RelayTuner around the setpoint in place of the PID, starting from the output the PID
+	// had.  The PID takes over again from a reset to that output when it finishes, on the gains
+	// found if it found any.  The result is in getStatus().tuning, and only goes into the settings with setGains().
+	void startAutotune(const RelayTuner::Config& config);
+
+	Status getStatus() const { return status.read(); }
+	int32_t getMeasurement() const { return getStatus().measurement; }
+	int32_t getOutput() const { return getStatus().output; }
+	Stats getStats() const { return getStatus().stats; }
+};
+
+#endif // _CONTROL_HPP__
@@ -0,0 +1,45 @@
+#ifndef _CRC_HPP__
+#define _CRC_HPP__
+
+// CRC-32 as in zlib and Ethernet, reflected polynomial 0xEDB88320.  The table is worked out by the
+// compiler and lives in flash, a byte is one lookup.  Chains like zlib's: pass the CRC so far to
+// carry on over more data.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace CRC {
+
+	inline constexpr uint32_t POLYNOMIAL { 0xEDB88320 };
+
+	constexpr std::array<uint32_t, 256> table() {
+
+		std::array<uint32_t, 256> t {};
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int bit = 0; bit < 8; ++bit) c = c & 1 ? (c >> 1) ^ POLYNOMIAL : c >> 1;
+			t[i] = c;
+		}
+		return t;
+	}
+
+	inline constexpr std::array<uint32_t, 256> TABLE { table() };
+
+	constexpr uint32_t crc32(const uint8_t* data, size_t bytes, uint32_t previous = 0) {
+
+		uint32_t c = ~previous;
+		for (size_t i = 0; i < bytes; ++i) c = TABLE[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+		return ~c;
+	}
+
+	inline uint32_t crc32(const void* data, size_t bytes, uint32_t previous = 0) {
+		return crc32(static_cast<const uint8_t*>(data), bytes, previous);
+	}
+
+	inline constexpr uint8_t CHECK_INPUT[] { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+	static_assert(crc32(CHECK_INPUT, sizeof(CHECK_INPUT)) == 0xCBF43926, "The standard check value.");
+}
+
+#endif // _CRC_HPP__
@@ -0,0 +1,50 @@
+#ifndef _DISPLAY_HPP__
+#define _DISPLAY_HPP__
+
+// Display backends for Menu<Display>.  Menu calls these directly on the concrete type so the
+// calls inline, there's no std::function or virtual in between.  A backend provides:
+//
+//	void drawLine(const char* str, int row, bool inverted, int font);	// row is in 8 pixel pages.
+//	void drawRectangle(int x1, int y1, int x2, int y2, uint8_t colour, bool filled);
+//	void scroll(int pages);		// The whole picture, positive is up.  What comes round the end is stale.
+//	void flush();		// Send what was drawn.  May be deferred until the next call.
+
+#include "hal.hpp"
+#include "framebuffer.hpp"
+#include "linecache.hpp"
+
+
+// Draws into a FrameBuffer and sends the changes by DMA.  OneBitDisplay renders the text on the
+// Pico, the simulated panel does on the host, and with a LineCache only lines it hasn't seen as
+// they are now.
+class FrameBufferDisplay {
+
+	FrameBuffer& frameBuffer;
+	LineCache* lineCache;
+
+public:
+	FrameBufferDisplay(FrameBuffer& frameBuffer, LineCache* lineCache = nullptr) : frameBuffer(frameBuffer), lineCache(lineCache) {}
+
+	void drawLine(const char* str, int row, bool inverted, int font) {
+		if (lineCache && lineCache->draw(frameBuffer, str, row, font, inverted)) return;
+		frameBuffer.writeString(0, row, str, font, inverted);
+		if (lineCache) lineCache->store(frameBuffer, str, row, font, inverted);
+	}
+	void drawRectangle(int x1, int y1, int x2, int y2, uint8_t colour, bool filled) { frameBuffer.rectangle(x1, y1, x2, y2, colour, filled); }
+	void scroll(int pages) { frameBuffer.scroll(pages); }
+	void flush() { frameBuffer.flush(); }
+};
+
+
+
+// Throws everything away.  For timing the menu logic on its own.
+class NullDisplay {
+
+public:
+	void drawLine(const char* str, int row, bool inverted, int font) {}
+	void drawRectangle(int x1, int y1, int x2, int y2, uint8_t colour, bool filled) {}
+	void scroll(int pages) {}
+	void flush() {}
+};
+
+#endif // _DISPLAY_HPP__
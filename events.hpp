@@ -0,0 +1,77 @@
+#ifndef _EVENTS_HPP__
+#define _EVENTS_HPP__
+
+// Input events from the GPIO interrupts to the main loop.  The interrupts only push a small
+// timestamped event and return, all the menu work and drawing happens in the main loop.
+
+#include "hal.hpp"
+#include <array>
+#include <atomic>
+
+
+struct InputEvent {
+	enum class Type : uint8_t { Clockwise, Anticlockwise, ButtonDown, ButtonUp, LongPress };
+
+	Type type;
+	uint8_t pin;
+	uint32_t timeUs;	// When the interrupt saw it.  Low 32 bits, good for intervals of an hour.
+};
+
+
+
+// Single producer, single consumer ring.  One side may be an interrupt, neither side ever waits or
+// disables interrupts.  Two interrupts pushing onto one queue would race on head, so each source
+// gets a queue of its own, however the interrupts happen to be prioritised.  head and tail run
+// freely and are only ever stored by their own side, so a plain load and store is enough, no
+// read-modify-write the M0+ would need a lock for.  A push onto a full ring drops the event and
+// counts it.
+template <typename T, uint SIZE>
+class EventQueue {
+
+	static_assert(SIZE && (SIZE & (SIZE - 1)) == 0, "SIZE must be a power of two.");
+
+	std::array<T, SIZE> ring;
+	std::atomic<uint32_t> head;		// Next to write.  Producer only.
+	std::atomic<uint32_t> tail;		// Next to read.  Consumer only.
+	std::atomic<uint32_t> dropped;	// Producer only.
+
+public:
+	EventQueue() : ring(), head(0), tail(0), dropped(0) {}
+
+	bool push(const T& item) {
+
+		auto h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) == SIZE) {
+			dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return false;
+		}
+		ring[h & (SIZE - 1)] = item;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool peek(T& item) const {
+
+		auto t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire)) return false;
+		item = ring[t & (SIZE - 1)];
+		return true;
+	}
+
+	bool pop(T& item) {
+
+		auto t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire)) return false;
+		item = ring[t & (SIZE - 1)];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const { return tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire); }
+	uint32_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+
+using InputQueue = EventQueue<InputEvent, 32>;
+
+#endif // _EVENTS_HPP__
@@ -0,0 +1,90 @@
+#ifndef _FIXED_HPP__
+#define _FIXED_HPP__
+
+// Signed fixed point in an int32_t, INT_BITS above the point and FRAC_BITS below it.  Everything
+// saturates at the ends of the range instead of wrapping, which is what a setting or a gain wants,
+// and nothing goes near floating point at run time: the M0+ has no FPU and every float operation
+// is a library call.  Only the double constructor is floating point, for constants the compiler
+// works out.
+
+#include <cstdint>
+#include <sys/types.h>
+
+
+template <uint I, uint F>
+class Fixed {
+
+	static_assert(I + F <= 31, "Fixed is a signed 32 bit value.");
+
+public:
+	static constexpr uint INT_BITS { I };
+	static constexpr uint FRAC_BITS { F };
+	static constexpr int32_t ONE { 1 << F };
+	static constexpr int32_t RAW_MAX { static_cast<int32_t>((1ull << (I + F)) - 1) };
+	static constexpr int32_t RAW_MIN { -RAW_MAX - 1 };
+
+private:
+	int32_t bits;
+
+	static constexpr int32_t saturate(int64_t value) {
+		return value > RAW_MAX ? RAW_MAX : value < RAW_MIN ? RAW_MIN : static_cast<int32_t>(value);
+	}
+
+	// Rounded half away from zero.  The division truncates towards zero, so n is moved half of d
+	// away from it first, whichever sign d has.
+	static constexpr int64_t divide(int64_t n, int64_t d) {
+		int64_t half = (d < 0 ? -d : d) / 2;
+		return (n < 0 ? n - half : n + half) / d;
+	}
+
+	static constexpr int64_t HALF { F ? int64_t(1) << (F - 1) : 0 };
+
+public:
+	constexpr Fixed() : bits(0) {}
+	constexpr Fixed(int value) : bits(saturate(static_cast<int64_t>(value) * ONE)) {}
+	explicit constexpr Fixed(double value) :
+				bits(value * ONE >= RAW_MAX ? RAW_MAX : value * ONE <= RAW_MIN ? RAW_MIN
+					 : static_cast<int32_t>(value < 0 ? value * ONE - 0.5 : value * ONE + 0.5)) {}
+
+	static constexpr Fixed fromRaw(int32_t raw) {
+		Fixed f;
+		f.bits = saturate(raw);
+		return f;
+	}
+	// numerator / denominator, rounded.  A zero denominator saturates.
+	static constexpr Fixed ratio(int64_t numerator, int64_t denominator) {
+		if (!denominator) return fromRaw(numerator < 0 ? RAW_MIN : RAW_MAX);
+		return fromRaw(saturate(divide(numerator * ONE, denominator)));
+	}
+	static constexpr Fixed max() { return fromRaw(RAW_MAX); }
+	static constexpr Fixed min() { return fromRaw(RAW_MIN); }
+
+	constexpr int32_t raw() const { return bits; }
+	constexpr int32_t round() const { return static_cast<int32_t>((static_cast<int64_t>(bits) + HALF) >> F); }	// Halves up.
+	constexpr double toDouble() const { return static_cast<double>(bits) / ONE; }	// Checks and the host only.
+
+	// value * this, rounded, for scaling an integer.
+	constexpr int64_t scale(int64_t value) const { return (value * bits + HALF) >> F; }
+
+	constexpr Fixed operator-() const { return fromRaw(saturate(-static_cast<int64_t>(bits))); }
+
+	// Friends so an int converts on either side.
+	friend constexpr Fixed operator+(Fixed a, Fixed b) { return fromRaw(saturate(static_cast<int64_t>(a.bits) + b.bits)); }
+	friend constexpr Fixed operator-(Fixed a, Fixed b) { return fromRaw(saturate(static_cast<int64_t>(a.bits) - b.bits)); }
+	friend constexpr Fixed operator*(Fixed a, Fixed b) { return fromRaw(saturate((static_cast<int64_t>(a.bits) * b.bits + HALF) >> F)); }
+	friend constexpr Fixed operator/(Fixed a, Fixed b) { return ratio(a.bits, b.bits); }
+
+	constexpr Fixed& operator+=(Fixed other) { return *this = *this + other; }
+	constexpr Fixed& operator-=(Fixed other) { return *this = *this - other; }
+	constexpr Fixed& operator*=(Fixed other) { return *this = *this * other; }
+	constexpr Fixed& operator/=(Fixed other) { return *this = *this / other; }
+
+	friend constexpr bool operator==(Fixed a, Fixed b) { return a.bits == b.bits; }
+	friend constexpr bool operator!=(Fixed a, Fixed b) { return a.bits != b.bits; }
+	friend constexpr bool operator<(Fixed a, Fixed b) { return a.bits < b.bits; }
+	friend constexpr bool operator<=(Fixed a, Fixed b) { return a.bits <= b.bits; }
+	friend constexpr bool operator>(Fixed a, Fixed b) { return a.bits > b.bits; }
+	friend constexpr bool operator>=(Fixed a, Fixed b) { return a.bits >= b.bits; }
+};
+
+#endif // _FIXED_HPP__
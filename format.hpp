@@ -0,0 +1,94 @@
+#ifndef _FORMAT_HPP__
+#define _FORMAT_HPP__
+
+// Number to text without the heap, locales or printf.  Floating point values are scaled to an
+// integer once and the digits come from integer division, which is all the M0+ can do quickly.
+// Fixed point, anything with FRAC_BITS and raw() like Fixed, is scaled without floating point.
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <sys/types.h>
+
+
+namespace Format {
+
+	inline constexpr uint8_t MAX_DECIMALS { 9 };
+	inline constexpr uint32_t POWERS_OF_TEN[MAX_DECIMALS + 1] { 1, 10, 100, 1'000, 10'000, 100'000, 1'000'000, 10'000'000, 100'000'000, 1'000'000'000 };
+
+
+	// Writes scaled / 10^decimals right aligned into the width chars at out, space padded.
+	// If it doesn't fit the field is filled with '#'.  Returns the number of chars used by the number.
+	inline uint rightAlignedScaled(char* out, uint width, int64_t scaled, bool showSign, uint8_t decimals) {
+
+		char digits[24];	// Reversed.
+		uint n = 0;
+		bool negative = scaled < 0;
+		uint64_t magnitude = negative ? -static_cast<uint64_t>(scaled) : static_cast<uint64_t>(scaled);
+
+		auto fraction = [&digits, &n](uint32_t value, uint count) {
+			for (uint i = 0; i < count; ++i) {
+				digits[n++] = '0' + value % 10;
+				value /= 10;
+			}
+		};
+		auto whole = [&digits, &n](auto value) {
+			do {
+				digits[n++] = '0' + value % 10;
+				value /= 10;
+			} while (value);
+		};
+
+		if (decimals) {
+			if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+			uint64_t integer = magnitude / POWERS_OF_TEN[decimals];
+			fraction(static_cast<uint32_t>(magnitude - integer * POWERS_OF_TEN[decimals]), decimals);
+			digits[n++] = '.';
+			magnitude = integer;
+		}
+		// Stay in 32 bits where possible, 64 bit division is a library call on the M0+.
+		if (magnitude <= UINT32_MAX) whole(static_cast<uint32_t>(magnitude));
+		else whole(magnitude);
+
+		if (negative) digits[n++] = '-';
+		else if (showSign) digits[n++] = '+';
+
+		if (n > width) {
+			for (uint i = 0; i < width; ++i) out[i] = '#';
+			return 0;
+		}
+		uint pad = width - n;
+		for (uint i = 0; i < pad; ++i) out[i] = ' ';
+		for (uint i = 0; i < n; ++i) out[pad + i] = digits[n - 1 - i];
+		return n;
+	}
+
+
+	template <typename T, typename = void>
+	struct IsFixedPoint : std::false_type {};
+	template <typename T>
+	struct IsFixedPoint<T, std::void_t<decltype(T::FRAC_BITS), decltype(std::declval<T>().raw())>> : std::true_type {};
+
+
+	// Writes value right aligned into the width chars at out, as rightAlignedScaled.
+	// Integers ignore decimals.  Fixed and floating point are rounded half away from zero.
+	template <typename T>
+	uint rightAligned(char* out, uint width, T value, bool showSign = false, uint8_t decimals = 0) {
+
+		if constexpr (std::is_integral_v<T>) {
+			return rightAlignedScaled(out, width, static_cast<int64_t>(value), showSign, 0);
+		} else if constexpr (IsFixedPoint<T>::value) {
+			if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+			int64_t scaled = static_cast<int64_t>(value.raw()) * POWERS_OF_TEN[decimals];
+			int64_t half = T::FRAC_BITS ? int64_t(1) << (T::FRAC_BITS - 1) : 0;
+			scaled = scaled < 0 ? -((half - scaled) >> T::FRAC_BITS) : (scaled + half) >> T::FRAC_BITS;
+			return rightAlignedScaled(out, width, scaled, showSign, decimals);
+		} else {
+			if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+			T scaled = value * static_cast<T>(POWERS_OF_TEN[decimals]);
+			return rightAlignedScaled(out, width, static_cast<int64_t>(scaled < 0 ? scaled - static_cast<T>(0.5) : scaled + static_cast<T>(0.5)), showSign, decimals);
+		}
+	}
+}
+
+#endif // _FORMAT_HPP__
@@ -0,0 +1,241 @@
+#include "framebuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+FrameBuffer::FrameBuffer(uint8_t* buffer) :
+			buffer(buffer),
+			shown(),
+			dirty(),
+			shownValid(false),
+			startPage(0),
+			panelStartPage(0),
+			transmit(),
+			words(0),
+			flushing(false),
+			sending(false),
+			sendStartUs(0),
+			flushedFunction(),
+			stats() {
+	invalidate();
+}
+
+
+void FrameBuffer::writeString(int x, int row, const char* str, int font, bool inverted) {
+
+	HAL::displayWriteString(x, row, str, font, inverted, false);
+
+	int lastColumn = x + static_cast<int>(std::strlen(str) * HAL::fontWidth(font)) - 1;
+	for (uint page = 0; page < HAL::fontPages(font); ++page)
+		markDirty(row + page, x, lastColumn);
+}
+
+
+void FrameBuffer::rectangle(int x1, int y1, int x2, int y2, uint8_t colour, bool filled) {
+
+	HAL::displayRectangle(x1, y1, x2, y2, colour, filled);
+
+	for (int page = std::min(y1, y2) / 8; page <= std::max(y1, y2) / 8; ++page)
+		markDirty(page, std::min(x1, x2), std::max(x1, x2));
+}
+
+
+// Rotating the buffer and its dirty spans with the start line leaves every page over the same RAM
+// page as before, so what's on the panel and what's still to send both stay right.
+void FrameBuffer::scroll(int pages) {
+
+	uint up = (pages % static_cast<int>(PAGES) + PAGES) % PAGES;
+	if (!up) return;
+
+	auto state = HAL::disableInterrupts();
+	std::rotate(buffer, buffer + up * WIDTH, buffer + SIZE);
+	std::rotate(dirty.begin(), dirty.begin() + up, dirty.end());
+	startPage = (startPage + up) % PAGES;
+	HAL::restoreInterrupts(state);
+}
+
+
+void FrameBuffer::markDirty(int page, int firstColumn, int lastColumn) {
+
+	if (page < 0 || page >= static_cast<int>(PAGES)) return;
+	firstColumn = std::max(firstColumn, 0);
+	lastColumn = std::min(lastColumn, static_cast<int>(WIDTH) - 1);
+	if (firstColumn > lastColumn) return;
+
+	auto& span = dirty[page];
+	if (span.empty()) {
+		span = Span { static_cast<uint8_t>(firstColumn), static_cast<uint8_t>(lastColumn) };
+	} else {
+		span.first = std::min<int>(span.first, firstColumn);
+		span.last = std::max<int>(span.last, lastColumn);
+	}
+}
+
+
+void FrameBuffer::markAllDirty() {
+	for (auto& span : dirty) span = Span { 0, WIDTH - 1 };
+}
+
+
+void FrameBuffer::invalidate() {
+	shownValid = false;
+	markAllDirty();
+}
+
+
+// The dirty span of a page narrowed to the bytes that really differ from the panel, were it showing
+// the page from RAM page start.
+FrameBuffer::Span FrameBuffer::changed(const Span& dirtySpan, uint page, uint start) const {
+
+	Span span = dirtySpan;
+	if (span.empty() || !shownValid) return span;
+
+	const uint8_t* now = buffer + page * WIDTH;
+	const uint8_t* was = shown.data() + ((page + start) % PAGES) * WIDTH;
+	while (span.first <= span.last && now[span.first] == was[span.first]) ++span.first;
+	while (span.last > span.first && now[span.last] == was[span.last]) --span.last;
+	return span;
+}
+
+
+// RAM pages are walked top to bottom and each changed span is either folded into the window above
+// it or starts a new one, whichever puts fewer bytes on the bus.
+template <typename Send>
+void FrameBuffer::plan(uint start, const std::array<Span, PAGES>& pages, Send&& send) {
+
+	Window window {};
+	bool open = false;
+	for (uint ram = 0; ram < PAGES; ++ram) {
+		uint page = (ram + PAGES - start) % PAGES;
+		Span span = changed(pages[page], page, start);
+		if (span.empty()) continue;
+
+		if (open) {
+			Window merged { window.firstPage, static_cast<uint8_t>(ram), std::min(window.firstColumn, span.first), std::max(window.lastColumn, span.last) };
+			if (merged.area() <= window.area() + (span.last - span.first + 1) + WINDOW_OVERHEAD) {
+				window = merged;
+				continue;
+			}
+			send(window);
+		}
+		window = Window { static_cast<uint8_t>(ram), static_cast<uint8_t>(ram), span.first, span.last };
+		open = true;
+	}
+	if (open) send(window);
+}
+
+
+uint FrameBuffer::bytesFor(uint start, const std::array<Span, PAGES>& pages) {
+
+	uint bytes = 0;
+	plan(start, pages, [&bytes](const Window& window){ bytes += WINDOW_OVERHEAD + window.area(); });
+	return bytes;
+}
+
+
+uint FrameBuffer::flush() {
+
+	// Take the dirty spans in one go, a draw from an interrupt may be adding to them.
+	std::array<Span, PAGES> pages;
+	auto state = HAL::disableInterrupts();
+	if (flushing || sending) {
+		bool anyDirty = false;
+		for (auto& span : dirty) anyDirty |= !span.empty();
+		if (anyDirty) ++stats.deferred;
+		HAL::restoreInterrupts(state);
+		return 0;
+	}
+	flushing = true;
+	pages = dirty;
+	for (auto& span : dirty) span = Span { 1, 0 };
+	HAL::restoreInterrupts(state);
+
+	words = 0;
+	uint before = stats.bytes;
+
+	// The buffer is right whichever page the panel starts from, so after a scroll every page is
+	// compared both ways and the cheaper one sent.
+	if (shownValid && startPage != panelStartPage) {
+		for (auto& span : pages) span = Span { 0, WIDTH - 1 };
+		if (bytesFor(panelStartPage, pages) <= bytesFor(startPage, pages) + START_LINE_BYTES + 1) startPage = panelStartPage;
+	}
+	if (!shownValid || startPage != panelStartPage) {
+		addStartLine();
+		panelStartPage = startPage;
+	}
+
+	bool first = true;
+	plan(startPage, pages, [this, &first](const Window& window){
+		add(window, first);
+		first = false;
+	});
+	shownValid = true;
+
+	if (words) {
+		++stats.flushes;
+		sending = true;
+		sendStartUs = HAL::timeUs();
+		HAL::displayWriteAsync(transmit.data(), words, &FrameBuffer::transferDone, this);
+	}
+	flushing = false;
+	return stats.bytes - before;
+}
+
+
+// Horizontal addressing so that one run of data fills the whole window.  The window is its own
+// I2C transaction, ended by a STOP on its last byte.
+void FrameBuffer::add(const Window& window, bool setMode) {
+
+	uint start = words;
+	auto command = [this](uint8_t byte) {
+		transmit[words++] = 0x80;	// Co = 1, D/C = 0.  One command byte follows.
+		transmit[words++] = byte;
+	};
+
+	if (setMode) {
+		command(0x20);
+		command(0x00);
+	}
+	command(0x21);
+	command(window.firstColumn);
+	command(window.lastColumn);
+	command(0x22);
+	command(window.firstPage);
+	command(window.lastPage);
+	transmit[words++] = 0x40;		// Co = 0, D/C = 1.  Data to the end.
+
+	for (uint ram = window.firstPage; ram <= window.lastPage; ++ram) {
+		uint from = ((ram + PAGES - startPage) % PAGES) * WIDTH + window.firstColumn;
+		uint to = ram * WIDTH + window.firstColumn;
+		uint length = window.lastColumn - window.firstColumn + 1;
+		for (uint i = 0; i < length; ++i) transmit[words++] = buffer[from + i];
+		std::memcpy(&shown[to], buffer + from, length);
+	}
+	transmit[words - 1] |= HAL::I2C_STOP;
+
+	++stats.transactions;
+	stats.bytes += words - start + 1;
+}
+
+
+// Its own transaction, ahead of the windows, so the pages drawn since the scroll land where they
+// are shown.
+void FrameBuffer::addStartLine() {
+
+	uint start = words;
+	transmit[words++] = 0x80;
+	transmit[words++] = (0x40 | startPage * 8) | HAL::I2C_STOP;
+
+	++stats.transactions;
+	stats.bytes += words - start + 1;
+}
+
+
+void FrameBuffer::transferDone(void* context) {
+
+	auto frameBuffer = static_cast<FrameBuffer*>(context);
+	frameBuffer->stats.busyUs += HAL::timeUs() - frameBuffer->sendStartUs;
+	frameBuffer->sending = false;
+	if (frameBuffer->flushedFunction) frameBuffer->flushedFunction();
+}
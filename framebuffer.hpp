@@ -0,0 +1,102 @@
+#ifndef _FRAMEBUFFER_HPP__
+#define _FRAMEBUFFER_HPP__
+
+// Back buffer for the 128x64 OLED.  Drawing only touches the buffer and records which columns of
+// which 8 pixel pages changed.  flush() then compares those spans against a copy of what the panel
+// already shows and sends just the bytes that differ, as few address windows as pay for themselves.
+//
+// The bytes are copied into a transmit buffer and streamed out by DMA, so flush() returns straight
+// away and the next frame can be drawn while the last one is on the bus.  A flush while the DMA is
+// still busy sends nothing and leaves the changes for the next call.
+//
+// scroll() moves the picture by whole pages with the controller's display start line, so the panel
+// RAM is used as a ring of pages.  The buffer is rotated to match, and only what's drawn afterwards
+// in the pages that came round the end has to be sent.  The next flush checks that this is cheaper
+// than redrawing the moved picture where the panel already has it.  With tall rows it may not be,
+// and then the start line stays as it was.
+
+#include "hal.hpp"
+#include <array>
+#include <functional>
+
+
+class FrameBuffer {
+
+public:
+	static constexpr uint WIDTH { 128 };
+	static constexpr uint PAGES { 8 };
+	static constexpr uint SIZE  { WIDTH * PAGES };
+
+	struct Stats {
+		uint32_t flushes;		// Ones that sent something.
+		uint32_t deferred;		// Ones that found the DMA busy.
+		uint32_t transactions;
+		uint32_t bytes;			// Everything put on the bus, addressing included.
+		uint64_t busyUs;		// Time from starting the DMA to the last STOP.
+	};
+
+private:
+	// Dirty columns [first, last] of a page.  first > last when clean.
+	struct Span {
+		uint8_t first;
+		uint8_t last;
+		bool empty() const { return first > last; }
+	};
+
+	// A rectangle of RAM pages and columns sent as one I2C transaction.
+	struct Window {
+		uint8_t firstPage, lastPage;
+		uint8_t firstColumn, lastColumn;
+		uint area() const { return (lastPage - firstPage + 1) * (lastColumn - firstColumn + 1); }
+	};
+
+	// Address byte, the column and page address commands with their control bytes and the data
+	// control byte.  A separate window only pays if it saves more than this.
+	static constexpr uint WINDOW_OVERHEAD { 1 + 12 + 1 };
+	static constexpr uint MODE_BYTES { 4 };
+	static constexpr uint START_LINE_BYTES { 2 };
+	static constexpr uint MAX_WORDS { START_LINE_BYTES + MODE_BYTES + PAGES * WINDOW_OVERHEAD + SIZE };
+
+	uint8_t* buffer;
+	std::array<uint8_t, SIZE> shown;	// What the panel holds once the DMA is done.
+	std::array<Span, PAGES> dirty;
+	bool shownValid;					// False until the panel has been written in full once.
+	uint8_t startPage;					// The RAM page at the top of the screen, as drawn.
+	uint8_t panelStartPage;				// As last sent.
+
+	std::array<uint16_t, MAX_WORDS> transmit;	// Read by the DMA while sending.
+	uint words;
+	volatile bool flushing;				// Stops a draw from an interrupt flushing over the top.
+	volatile bool sending;
+	uint64_t sendStartUs;
+	std::function<void()> flushedFunction;
+	Stats stats;
+
+	Span changed(const Span& dirtySpan, uint page, uint start) const;
+	template <typename Send>
+	void plan(uint start, const std::array<Span, PAGES>& pages, Send&& send);
+	uint bytesFor(uint start, const std::array<Span, PAGES>& pages);
+	void add(const Window& window, bool setMode);
+	void addStartLine();
+	static void transferDone(void* context);
+
+public:
+	FrameBuffer(uint8_t* buffer);
+
+	uint8_t* data() { return buffer; }
+
+	void writeString(int x, int row, const char* str, int font, bool inverted);
+	void rectangle(int x1, int y1, int x2, int y2, uint8_t colour, bool filled);
+	void scroll(int pages);		// Positive moves the picture up.  The pages it uncovers keep what went off the other end.
+
+	void markDirty(int page, int firstColumn, int lastColumn);
+	void markAllDirty();
+	void invalidate();			// Forget what the panel shows, the next flush sends everything.
+
+	uint flush();				// Returns the number of bytes started.
+	bool busy() const { return sending; }
+	void setFlushedFunction(const std::function<void()>& func) { flushedFunction = func; }	// Runs in interrupt context.
+	const Stats& getStats() const { return stats; }
+};
+
+#endif // _FRAMEBUFFER_HPP__
@@ -12,8 +12,21 @@
 InterruptableGPIO::InterruptableGPIO(uint8_t pin) : 
 			enabled(true),
 			pin(pin) {
-	interruptableGPIOs[pin] = this;
-	gpio_set_dir(pin, false);
+	HAL::gpioInitInput(pin);
+	if (pin >= HAL::NUM_GPIOS) return;
+	auto state = HAL::disableInterrupts();
+	handlers[pin] = this;
+	HAL::restoreInterrupts(state);
+}
+
+
+InterruptableGPIO::~InterruptableGPIO() {
+
+	if (pin >= HAL::NUM_GPIOS) return;
+	HAL::gpioSetIrqEnabled(pin, HAL::EDGE_FALL + HAL::EDGE_RISE, false);
+	auto state = HAL::disableInterrupts();
+	if (handlers[pin] == this) handlers[pin] = nullptr;
+	HAL::restoreInterrupts(state);
 }
 
 
@@ -26,22 +39,51 @@ InterruptableGPIO& InterruptableGPIO::operator=(InterruptableGPIO&& other) {
 
 void InterruptableGPIO::gpioInterruptHandler(uint gpio, uint32_t events) {
 
-	for (auto it = interruptableGPIOs.begin(); it != interruptableGPIOs.end(); ++it) {
-		auto& interruptableGPIO = it->second;
-		if (interruptableGPIO->enabled && gpio == interruptableGPIO->pin) {
-			interruptableGPIO->triggered(gpio, events);
-		}
- 	}
+#ifdef TEC_IRQ_LATENCY
+	IrqLatency::record(gpio, HAL::timeUs());
+#endif
+	if (gpio >= HAL::NUM_GPIOS) return;
+	auto handler = handlers[gpio];
+	if (handler && handler->enabled) handler->triggered(gpio, events);
+}
+
+
+#ifdef TEC_IRQ_LATENCY
+namespace {
+	IrqLatency::Stats latency { 0, UINT32_MAX, 0, 0 };
+}
+
+
+void IrqLatency::record(uint gpio, uint64_t enteredUs) {
+
+	auto edge = HAL::gpioEdgeUs(gpio);
+	if (!edge || edge > enteredUs) return;
+	uint32_t us = enteredUs - edge;
+	++latency.count;
+	latency.minUs = std::min(latency.minUs, us);
+	latency.maxUs = std::max(latency.maxUs, us);
+	latency.totalUs += us;
 }
 
 
+const IrqLatency::Stats& IrqLatency::stats() { return latency; }
+
+
+void IrqLatency::reset() {
+	auto state = HAL::disableInterrupts();
+	latency = Stats { 0, UINT32_MAX, 0, 0 };
+	HAL::restoreInterrupts(state);
+}
+#endif
+
+
 // int64_t InterruptableGPIO::reenableGPIOCallback(alarm_id_t id, void* userData) {
 
 // 	auto pinPtr = static_cast<uint8_t*>(userData);
 // 	auto pin = *pinPtr;
 // 	auto& vec = InterruptableGPIO::interruptableGPIOs;
 // 	auto result = std::find_if(vec.begin(), vec.end(), [pin](auto& gp) { return gp.second->pin == pin;});
-// 	if (result != std::end(vec)) { (*result).second->enabled = true; gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_FALL, true); }
+// 	if (result != std::end(vec)) { (*result).second->enabled = true; HAL::gpioSetIrqEnabled(pin, HAL::EDGE_FALL, true); }
 // 	return 0;
 // }
 
@@ -52,7 +94,7 @@ void InterruptableGPIO::gpioInterruptHandler(uint gpio, uint32_t events) {
 
 RotaryEncoderEncoderGPIO::RotaryEncoderEncoderGPIO(uint8_t pin, RotaryEncoder* parent) : InterruptableGPIO(pin), parent(parent) {
 
-	gpio_set_irq_enabled_with_callback(pin, GPIO_IRQ_EDGE_FALL + GPIO_IRQ_EDGE_RISE, true, &InterruptableGPIO::gpioInterruptHandler);
+	HAL::gpioSetIrqEnabledWithCallback(pin, HAL::EDGE_FALL + HAL::EDGE_RISE, true, &InterruptableGPIO::gpioInterruptHandler);
 }
 
 void RotaryEncoderEncoderGPIO::triggered(uint gpio, uint32_t events) { 
@@ -61,88 +103,93 @@ void RotaryEncoderEncoderGPIO::triggered(uint gpio, uint32_t events) {
 
 
 
-// PushButtonGPIO
-
-PushButtonGPIO::PushButtonGPIO(uint8_t pin, PushButton* parent, uint debounceMS) : InterruptableGPIO(pin), parent(parent), debounceMS(debounceMS), t(), count(0), buttonState(ButtonState::NotPressed) {
+// ButtonDebouncer
 
-	gpio_set_irq_enabled_with_callback(pin, GPIO_IRQ_EDGE_FALL, true, &InterruptableGPIO::gpioInterruptHandler);
-	gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE, false);
-}
+void ButtonDebouncer::add(uint pin, PushButton* button) {
 
+	if (pin >= HAL::NUM_GPIOS) return;
+	HAL::gpioInitInput(pin);
 
-bool PushButtonGPIO::debounceTimerCallback(repeating_timer_t* t) {
+	auto irqState = HAL::disableInterrupts();
+	bool start = mask == 0;
+	buttons[pin] = button;
+	mask |= 1u << pin;
+	HAL::restoreInterrupts(irqState);
 
-	PushButtonGPIO* gpio = static_cast<PushButtonGPIO*>(t->user_data);
+	// Negative so the ticks are a fixed time apart however long one takes.
+	if (start) HAL::addRepeatingTimerMs(-static_cast<int32_t>(IO::DEBOUNCE_MS), tick, nullptr, &timer);
+}
 
-	if (gpio_get(gpio->pin) == 0 && gpio->buttonState == ButtonState::Pressed) {
-		if (++gpio->count == gpio->debounceMS) {
-			gpio->count = 0;
-			gpio_set_irq_enabled_with_callback(gpio->pin, GPIO_IRQ_EDGE_RISE, true, &InterruptableGPIO::gpioInterruptHandler);
-			gpio->parent->buttonDown();
-			return false;
-		}
-	} else if (gpio_get(gpio->pin) == 1 && gpio->buttonState == ButtonState::NotPressed) {
-		if (++gpio->count == gpio->debounceMS) {
-			gpio->count = 0;
-			gpio_set_irq_enabled_with_callback(gpio->pin, GPIO_IRQ_EDGE_FALL, true, &InterruptableGPIO::gpioInterruptHandler);
-			gpio->parent->buttonUp();
-			return false;
-		}
-	} else if (gpio->buttonState == ButtonState::Pressed) {
-		gpio->buttonState = ButtonState::NotPressed;
-		gpio_set_irq_enabled_with_callback(gpio->pin, GPIO_IRQ_EDGE_FALL + GPIO_IRQ_EDGE_RISE, true, &InterruptableGPIO::gpioInterruptHandler);
-		return false;
-	} else {
-		gpio->buttonState = ButtonState::Pressed;
-		gpio_set_irq_enabled_with_callback(gpio->pin, GPIO_IRQ_EDGE_FALL + GPIO_IRQ_EDGE_RISE, true, &InterruptableGPIO::gpioInterruptHandler);
-		return false;
-	}
-	return true;
-} 
 
+void ButtonDebouncer::remove(uint pin, PushButton* button) {
 
-// tell it the button state is what it is.  turn off the interrupt and set an alarm 
-void PushButtonGPIO::triggered(uint gpio, uint32_t events) {
+	if (pin >= HAL::NUM_GPIOS || buttons[pin] != button) return;
 
-	gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_FALL + GPIO_IRQ_EDGE_RISE, false);
+	auto irqState = HAL::disableInterrupts();
+	buttons[pin] = nullptr;
+	uint32_t bit = 1u << pin;
+	mask &= ~bit;
+	state &= ~bit;
+	longPressed &= ~bit;
+	count0 |= bit;
+	count1 |= bit;
+	bool stop = mask == 0;
+	HAL::restoreInterrupts(irqState);
 
-	if (events == GPIO_IRQ_EDGE_FALL) {
-		buttonState = ButtonState::Pressed;
-	} else if (events == GPIO_IRQ_EDGE_RISE) {
-		buttonState = ButtonState::NotPressed;
-	}
-	
-	add_repeating_timer_ms(1, debounceTimerCallback, this, &t);
+	if (stop) HAL::cancelRepeatingTimer(&timer);
 }
 
 
+bool ButtonDebouncer::tick(HAL::RepeatingTimer* t) {
 
+	auto now = HAL::timeUs();
+	uint32_t sample = ~HAL::gpioGetAll() & mask;
 
-// PushButton
-
-PushButton::PushButton (uint gpio, std::function<void()> buttonDownFunction, std::function<void()> buttonUpFunction, std::function<void()> buttonLongPressFunction = {}, uint longPressTime = 1500, uint debounceMS = 5) : buttonGPIO(gpio, this, debounceMS), buttonDownFunction(buttonDownFunction), buttonUpFunction(buttonUpFunction), buttonLongPressFunction(buttonLongPressFunction), longPressTime(longPressTime) {}
+	// Count down the pins that differ from the debounced state, reset the rest to 3.  The ones that
+	// wrap past 0 have differed for SAMPLES ticks and change state.
+	uint32_t differ = state ^ sample;
+	count0 = ~(count0 & differ);
+	count1 = count0 ^ (count1 & differ);
+	uint32_t changed = differ & count0 & count1;
+	state ^= changed;
 
+	uint32_t pressed = changed & state;
+	uint32_t released = changed & ~state;
+	longPressed &= ~released;
 
-void PushButton::buttonUp() {
-	if (buttonLongPressFunction) {
-		cancel_alarm(longPressAlarmID);
+	for (uint32_t bits = changed; bits; bits &= bits - 1) {
+		uint pin = __builtin_ctz(bits);
+		if (pressed & (1u << pin)) {
+			pressedUs[pin] = now;
+			buttons[pin]->push(InputEvent::Type::ButtonDown, now);
+		} else {
+			buttons[pin]->push(InputEvent::Type::ButtonUp, now);
+		}
+	}
+	for (uint32_t bits = state & ~longPressed; bits; bits &= bits - 1) {
+		uint pin = __builtin_ctz(bits);
+		if (now - pressedUs[pin] >= buttons[pin]->longPressTimeUs()) {
+			longPressed |= 1u << pin;
+			buttons[pin]->push(InputEvent::Type::LongPress, now);
+		}
 	}
-	buttonUpFunction();	
+	return true;
 }
 
-void PushButton::buttonDown() {
-	if (buttonLongPressFunction)
-		longPressAlarmID = add_alarm_in_ms(longPressTime, &longPressCallback, this, true);
-	buttonDownFunction();
+
+
+// PushButton
+
+PushButton::PushButton (uint gpio, InputQueue& events, uint longPressTime) : pin(gpio), events(events), longPressUs(longPressTime * 1000ull) {
+	ButtonDebouncer::add(pin, this);
 }
 
-int64_t PushButton::longPressCallback(alarm_id_t id, void* userData) {
-	auto button = static_cast<PushButton*>(userData);
-	//it hits the next menu and wants to do button up.
-	//gpio_set_irq_enabled(button->buttonGPIO.pin, GPIO_IRQ_EDGE_RISE, false);
 
-	button->buttonLongPressFunction();
-	return 0;
+PushButton::~PushButton() { ButtonDebouncer::remove(pin, this); }
+
+
+void PushButton::push(InputEvent::Type type, uint64_t timeUs) {
+	events.push(InputEvent{ type, pin, static_cast<uint32_t>(timeUs) });
 }
 
 
@@ -181,29 +228,42 @@ const std::array<std::array<uint8_t, 4>, 7> ttable {
 };
 
 
-RotaryEncoder::RotaryEncoder(const uint8_t p1, const uint8_t p2, const uint8_t buttonPin, std::function<void()> ccFunction, std::function<void()> cFunction, std::function<void()> butDownFunc, std::function<void()> butUpFunc, std::function<void()> longPressFunc = {}) : 
+RotaryEncoder::RotaryEncoder(const uint8_t p1, const uint8_t p2, const uint8_t buttonPin, InputQueue& events, InputQueue& buttonEvents) : 
 					p1(p1, this),
 					p2(p2, this),
-					button(buttonPin, butDownFunc, butUpFunc, longPressFunc),
+					button(buttonPin, buttonEvents),
 					state(R_START),
-					ccFunction(ccFunction),
-					cFunction(cFunction)
-{}
-
-RotaryEncoder::RotaryEncoder(uint8_t p1, uint8_t p2, std::function<void()> ccFunction, std::function<void()> cFunction) : 
-		RotaryEncoder(p1, p2, 255, ccFunction, cFunction, {}, {}, {})
+					events(events)
 {}
 
 
 void RotaryEncoder::triggered(uint gpio, uint32_t events) {
 
-	uint8_t pinstate = (gpio_get(PIN::ENCODER_PIN1) << 1) | gpio_get(PIN::ENCODER_PIN2);
+	uint8_t pinstate = (HAL::gpioGet(PIN::ENCODER_PIN1) << 1) | HAL::gpioGet(PIN::ENCODER_PIN2);
 	state = ttable[state & 0xF][pinstate];
 	
 	if ((state & 0x30) == DIR_CW) {
-		cFunction();
+		this->events.push(InputEvent{ InputEvent::Type::Clockwise, static_cast<uint8_t>(gpio), static_cast<uint32_t>(HAL::timeUs()) });
 	} else if ((state & 0x30) == DIR_CCW) {
-		ccFunction();
+		this->events.push(InputEvent{ InputEvent::Type::Anticlockwise, static_cast<uint8_t>(gpio), static_cast<uint32_t>(HAL::timeUs()) });
 	}
 }
 
+
+
+#ifdef TEC_IRQ_LATENCY
+// LatencyProbe
+
+LatencyProbe::LatencyProbe(uint8_t pin) : InterruptableGPIO(pin), level(false) {
+
+	HAL::gpioInitOutput(pin);
+	HAL::gpioPut(pin, level);
+	HAL::gpioSetIrqEnabledWithCallback(pin, HAL::EDGE_FALL + HAL::EDGE_RISE, true, &InterruptableGPIO::gpioInterruptHandler);
+}
+
+
+void LatencyProbe::toggle() {
+	level = !level;
+	HAL::gpioPut(pin, level);
+}
+#endif
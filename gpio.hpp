@@ -2,81 +2,103 @@
 #define _GPIO_HPP__
 
 
-#include "pico/stdlib.h"
-#include "hardware/irq.h"
+#include "hal.hpp"
+#include "events.hpp"
 
 //#include <vector>
-#include <map>
+#include <array>
 #include <functional>
 #include <memory>
 #include <iostream>
 
 
-#pragma message "TODO: Give unique id to Interruptable GPIOs so they can be removed on object destruction.  Disabled etc."
-#pragma message "Move long press to PushButtonGPIO???"
 
+#ifdef TEC_IRQ_LATENCY
+// Time from an edge to its handler starting, for edges whose time is known (see HAL::gpioEdgeUs).
+namespace IrqLatency {
 
+	struct Stats {
+		uint32_t count;
+		uint32_t minUs;
+		uint32_t maxUs;
+		uint64_t totalUs;
+	};
+
+	void record(uint gpio, uint64_t enteredUs);	// From the interrupt handler.
+	const Stats& stats();
+	void reset();
+}
+#endif
+
+
+
+// One handler per pin, looked up by pin number in the interrupt.  A pin's interrupt is switched
+// off before its handler goes away, and the table is only changed with interrupts disabled.
 class InterruptableGPIO {
 	
-	inline static std::map<uint, InterruptableGPIO*> interruptableGPIOs;
+	inline static std::array<InterruptableGPIO*, HAL::NUM_GPIOS> handlers {};
 	virtual void triggered(uint gpio, uint32_t events) = 0;
 
 protected:
 	bool enabled;
 	InterruptableGPIO(uint8_t pin);
-	~InterruptableGPIO() { interruptableGPIOs.erase(pin); };
+	~InterruptableGPIO();
 
 public:
 	InterruptableGPIO& operator=(InterruptableGPIO&& other);
 	
 	uint8_t pin;
 	void disable() { enabled = false; }
-	static int64_t reenableGPIOCallback(alarm_id_t id, void* userData);
+	static int64_t reenableGPIOCallback(HAL::AlarmID id, void* userData);
 	static void gpioInterruptHandler(uint gpio, uint32_t events);
 };
 
 
 
+// All the push buttons are sampled together on one timer tick, as one word of the GPIO inputs.
+// Each pin has a two bit vertical counter, so a change has to be seen on SAMPLES ticks in a row
+// before it counts, and every pin is debounced in the same few instructions.  Long presses are
+// timed from the same tick, there are no per button timers or alarms.
+// Buttons are active low.
+
 class PushButton;
 
-class PushButtonGPIO : public InterruptableGPIO {
+class ButtonDebouncer {
 
-public:
-	enum class ButtonState { NotPressed, Pressed };
+	static constexpr uint SAMPLES { 4 };
 
-private:
-	PushButton* parent;
-	uint debounceMS;
-	repeating_timer t;
-	uint count;
+	inline static std::array<PushButton*, HAL::NUM_GPIOS> buttons {};
+	inline static std::array<uint64_t, HAL::NUM_GPIOS> pressedUs {};
+	inline static uint32_t mask { 0 };		// Pins with a button.
+	inline static uint32_t state { 0 };		// Debounced, set while pressed.
+	inline static uint32_t count0 { ~0u };	// The vertical counters, low and high bits.
+	inline static uint32_t count1 { ~0u };
+	inline static uint32_t longPressed { 0 };	// Held long enough and already reported.
+	inline static HAL::RepeatingTimer timer {};
 
-	static bool debounceTimerCallback(repeating_timer_t *t);
+	static bool tick(HAL::RepeatingTimer* t);
 
 public:
-	PushButtonGPIO(uint8_t pin, PushButton* parent, uint debounceMS);
-	ButtonState buttonState;
-	void triggered(uint gpio, uint32_t events) override;
+	static void add(uint pin, PushButton* button);
+	static void remove(uint pin, PushButton* button);
 };
 
 
 
-
+// Pushes ButtonDown, ButtonUp and LongPress events for ButtonDebouncer.
 class PushButton {
 
 private:
-	PushButtonGPIO buttonGPIO;
-	std::function<void()> buttonDownFunction;
-	std::function<void()> buttonUpFunction;
-	std::function<void()> buttonLongPressFunction;
-
-	uint longPressTime;
-	alarm_id_t longPressAlarmID;
-	static int64_t longPressCallback(alarm_id_t id, void* userData);
+	uint8_t pin;
+	InputQueue& events;
+	uint64_t longPressUs;
+
 public:
-	PushButton (uint gpio, std::function<void()> buttonDownFunction, std::function<void()> buttonUpFunction, std::function<void()> buttonLongPressFunction, uint longPressTime, uint debounceMS);
+	PushButton (uint gpio, InputQueue& events, uint longPressTime = 1500);
+	~PushButton();
 
-	void buttonUp();
-	void buttonDown();
+	uint64_t longPressTimeUs() const { return longPressUs; }
+	void push(InputEvent::Type type, uint64_t timeUs);
 };
 
 
@@ -91,6 +113,8 @@ public:
 
 
 
+// Pushes a Clockwise or Anticlockwise event per detent from the GPIO interrupt.  The button's
+// events come from the debounce timer's interrupt, so they go on a queue of their own.
 class RotaryEncoder {
 
 	RotaryEncoderEncoderGPIO p1;
@@ -98,19 +122,27 @@ class RotaryEncoder {
 	PushButton button;
 	uint8_t state;
 
-	std::function<void()> ccFunction;
-	std::function<void()> cFunction;
+	InputQueue& events;
 
 public:
-	RotaryEncoder(const uint8_t p1, const uint8_t p2, const uint8_t buttonPin, std::function<void()> ccFunction, std::function<void()> cFunction, std::function<void()> butDownFunc, std::function<void()> butUpFunc, std::function<void()> longPressFunc);
-
-	RotaryEncoder(const uint8_t p1, const uint8_t p2, std::function<void()> ccFunction, std::function<void()> cFunction);
+	RotaryEncoder(const uint8_t p1, const uint8_t p2, const uint8_t buttonPin, InputQueue& events, InputQueue& buttonEvents);
 
 	void triggered(uint gpio, uint32_t events);
+};
+
 
-	void buttonDown();
-	void buttonUp();
+
+#ifdef TEC_IRQ_LATENCY
+// Toggles an output pin, which also interrupts as an input, so the latency can be measured on the
+// board where nothing else knows when an edge happened.  The pin must be free.
+class LatencyProbe : public InterruptableGPIO {
+	bool level;
+	void triggered(uint gpio, uint32_t events) override {}
+public:
+	LatencyProbe(uint8_t pin);
+	void toggle();
 };
+#endif
 
 #endif // _GPIO_HPP__
 
@@ -0,0 +1,171 @@
+#ifndef _HAL_HPP__
+#define _HAL_HPP__
+
+// Thin hardware abstraction used by main, menu and gpio.
+// hal_pico.cpp implements it with the Pico SDK and OneBitDisplay, host/hal_host.cpp implements it
+// against the simulated board in host/sim.cpp so the same sources build and run on Linux.
+
+#ifdef TEC_HOST_SIM
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+#else
+#include "pico/stdlib.h"
+#endif
+
+
+namespace HAL {
+
+#ifdef TEC_HOST_SIM
+	using AlarmID = int32_t;
+
+	struct RepeatingTimer;
+	using RepeatingTimerCallback = bool (*)(RepeatingTimer* t);
+
+	// Same fields the firmware reads from the SDK's repeating_timer.
+	struct RepeatingTimer {
+		int64_t delayUs;
+		AlarmID alarmID;
+		RepeatingTimerCallback callback;
+		void* user_data;
+	};
+#else
+	using AlarmID = alarm_id_t;
+	using RepeatingTimer = repeating_timer_t;
+	using RepeatingTimerCallback = repeating_timer_callback_t;
+#endif
+
+	using AlarmCallback = int64_t (*)(AlarmID id, void* userData);
+	using GPIOCallback = void (*)(uint gpio, uint32_t events);
+	using TransferDone = void (*)(void* context);	// Called from interrupt context.
+	using PWMWrapCallback = void (*)(uint slice);
+
+	inline constexpr uint NUM_GPIOS { 30 };
+
+	// Match the values of the SDK's GPIO_IRQ_EDGE_*.
+	inline constexpr uint32_t EDGE_FALL { 0x4 };
+	inline constexpr uint32_t EDGE_RISE { 0x8 };
+
+	// Words for the display DMA go straight into the I2C controller's DATA_CMD register: the byte in
+	// bits 0-7 and I2C_STOP set on the last byte of each transaction.
+	inline constexpr uint16_t I2C_STOP { 0x200 };
+
+	// Match OneBitDisplay's font enum.
+	inline constexpr int FONT_8x8   { 1 };
+	inline constexpr int FONT_12x16 { 2 };
+
+	constexpr uint fontWidth(int font) { return font == FONT_12x16 ? 12 : 8; }
+	constexpr uint fontPages(int font) { return font == FONT_12x16 ? 2 : 1; }
+
+
+// System
+	void stdioInit();
+	uint64_t timeUs();
+	void sleepMs(uint32_t ms);
+	void busyWaitMs(uint32_t ms);
+	void idle();	// Body of a spin loop.  Lets the simulation advance time.
+	// Sleeps until an interrupt or the time, whichever is first, and may return early.  An
+	// interrupt that came in after the caller last looked wakes it straight away, so look, then
+	// sleep, never misses one.
+	void sleepUntil(uint64_t us);
+	uint32_t disableInterrupts();		// On this core only.
+	void restoreInterrupts(uint32_t state);
+
+// Console.  The stdio UART, for commands from a host, without going through stdio's buffers.
+	int consoleRead();			// The next character, -1 if none is waiting.
+	void consoleWrite(const char* text, size_t bytes);
+	void consoleSetInputCallback(void (*callback)());	// From interrupt context, when characters come in.
+
+// Cores
+	// Runs entry on core 1.  When it returns the core sleeps, still taking its interrupts.  The
+	// simulation has one thread, so there entry runs straight away and timers all share one pool.
+	void launchCore1(void (*entry)());
+	// Gives the calling core its own timer pool, so timers it adds interrupt it and not core 0.
+	void timerInitCore();
+
+// GPIO
+	void gpioInitInput(uint pin);
+	bool gpioGet(uint pin);
+	uint32_t gpioGetAll();		// All the pins, bit n is GPIO n.
+	void gpioInitOutput(uint pin);
+	void gpioPut(uint pin, bool level);
+	// When the pin last changed, 0 if not known.  The simulation knows for every edge, the Pico only
+	// for the ones it makes itself with gpioPut, and only when built with TEC_IRQ_LATENCY.
+	uint64_t gpioEdgeUs(uint pin);
+	void gpioSetIrqEnabled(uint pin, uint32_t events, bool enabled);
+	void gpioSetIrqEnabledWithCallback(uint pin, uint32_t events, bool enabled, GPIOCallback callback);
+
+// Timers
+	// Negative delays are fixed rate, measured from the start of the last call, as in the SDK.
+	bool addRepeatingTimerMs(int32_t ms, RepeatingTimerCallback callback, void* userData, RepeatingTimer* out);
+	bool addRepeatingTimerUs(int64_t us, RepeatingTimerCallback callback, void* userData, RepeatingTimer* out);
+	bool cancelRepeatingTimer(RepeatingTimer* timer);
+	AlarmID addAlarmInMs(uint32_t ms, AlarmCallback callback, void* userData);
+	bool cancelAlarm(AlarmID id);
+
+// PWM
+	void pwmInitPin(uint pin);	// Routes the pin to its slice and sets drive strength.
+	uint pwmSliceForPin(uint pin);
+	void pwmSetWrap(uint slice, uint16_t wrap);
+	void pwmSetOutputPolarity(uint slice, bool invertA, bool invertB);
+	void pwmSetPhaseCorrect(uint slice, bool phaseCorrect);
+	// One register write, so both channels always change at the same wrap.
+	void pwmSetBothLevels(uint slice, uint16_t levelA, uint16_t levelB);
+	void pwmSetEnabled(uint slice, bool enabled);
+	// Calls callback from the wrap interrupt, at every wrap of the slice, until disabled.
+	void pwmSetWrapIrq(uint slice, bool enabled, PWMWrapCallback callback);
+
+// ADC.  12 bit, channels 0-3 are GPIO 26-29.
+	inline constexpr uint ADC_FIRST_PIN { 26 };
+	inline constexpr uint ADC_CHANNELS { 4 };
+	inline constexpr uint16_t ADC_MAX { 4095 };
+	void adcInit(uint channel);
+	uint16_t adcRead(uint channel);		// Not while capturing.
+	// Free running capture.  The ADC converts the channels in channelMask round robin, lowest first,
+	// sampleRateHz conversions in all, and DMA writes them into ring over and over again with no
+	// interrupts at all.  samples must be a multiple of the number of channels, so each place in the
+	// ring always holds the same channel.
+	void adcStartCapture(uint32_t channelMask, uint32_t sampleRateHz, uint16_t* ring, size_t samples);
+	// The same but each conversion starts at a wrap of the PWM slice, on one in every wraps (a power
+	// of two up to 16), so it always lands at the same point of the switching cycle.  For phase
+	// correct that is the counter back at 0, the middle of the pulse below the levels.  The slice
+	// must be running.
+	void adcStartCaptureOnPwmWrap(uint32_t channelMask, uint slice, uint wraps, uint16_t* ring, size_t samples);
+	void adcStopCapture();
+	size_t adcCaptureIndex();		// Where in the ring the next sample will go.
+
+// Flash.  A region of FLASH_STORE_BYTES at the top of the chip, after the image, for settings.
+// Reads come straight from the memory map.  Erasing turns every bit back to 1 and programming can
+// only turn bits to 0, so a page can be programmed again as long as only erased bytes change.
+// Both stop the other core, and every interrupt, until they finish: about 0.5 ms a page and
+// 50 ms a sector.  They fail if the image has grown into the region.
+	inline constexpr uint32_t FLASH_SECTOR_BYTES { 4096 };
+	inline constexpr uint32_t FLASH_PAGE_BYTES { 256 };
+	inline constexpr uint32_t FLASH_STORE_BYTES { 4 * FLASH_SECTOR_BYTES };
+	const uint8_t* flashStore();
+	bool flashErase(uint32_t offset);						// The sector at offset into the region.
+	bool flashProgram(uint32_t offset, const uint8_t* page);	// One page, from RAM.
+
+// UART.  Transmit only, for telemetry.
+	void uartInit(uint txPin, uint32_t baud);
+	// Sends bytes by DMA and returns straight away.  data must stay untouched until done is called,
+	// which is once the last byte is in the UART's FIFO.  Only one transfer at a time.
+	void uartWriteAsync(const uint8_t* data, size_t bytes, TransferDone done, void* context);
+	bool uartBusy();
+
+// I2C
+	void i2cInit(uint sdaPin, uint sclPin, uint32_t freq);
+
+// Display (128x64 one bit OLED)
+	void displayInit();
+	void displaySetBackBuffer(uint8_t* buffer);
+	void displayWriteString(int x, int row, const char* str, int font, bool inverted, bool render);
+	void displayRectangle(int x1, int y1, int x2, int y2, uint8_t colour, bool filled);
+	void displayDumpBuffer(const uint8_t* buffer);
+	// Streams I2C words to the controller by DMA and returns straight away.  words must stay
+	// untouched until done is called.  Only one transfer at a time.
+	void displayWriteAsync(const uint16_t* words, size_t count, TransferDone done, void* context);
+	bool displayBusy();
+}
+
+#endif // _HAL_HPP__
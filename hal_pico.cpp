@@ -0,0 +1,561 @@
+#include "hal.hpp"
+#include "main.hpp"
+#include "hardware/pwm.h"
+#include "hardware/adc.h"
+#include "hardware/i2c.h"
+#include "hardware/uart.h"
+#include "hardware/irq.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "hardware/flash.h"
+#include "hardware/structs/scb.h"
+#include "pico/flash.h"
+#include "pico/multicore.h"
+#include "OLED/oneBitDisplay.h"
+#include <array>
+
+
+static_assert(HAL::NUM_GPIOS == NUM_BANK0_GPIOS);
+static_assert(HAL::EDGE_FALL == GPIO_IRQ_EDGE_FALL && HAL::EDGE_RISE == GPIO_IRQ_EDGE_RISE);
+static_assert(HAL::FONT_8x8 == FONT_8x8 && HAL::FONT_12x16 == FONT_12x16);
+static_assert(HAL::I2C_STOP == I2C_IC_DATA_CMD_STOP_BITS);
+static_assert(HAL::FLASH_SECTOR_BYTES == FLASH_SECTOR_SIZE && HAL::FLASH_PAGE_BYTES == FLASH_PAGE_SIZE);
+static_assert(HAL::FLASH_STORE_BYTES % FLASH_SECTOR_SIZE == 0 && HAL::FLASH_STORE_BYTES < PICO_FLASH_SIZE_BYTES);
+
+extern "C" char __flash_binary_end;		// From the linker script.
+
+
+namespace {
+	OBDISP oled;
+
+	// Core 0 uses the SDK's default pool, core 1 gets its own on another hardware alarm.
+	constexpr uint CORE1_HARDWARE_ALARM { 2 };
+	constexpr uint CORE1_MAX_TIMERS { 8 };
+	alarm_pool_t* core1Pool { nullptr };
+	void (*core1Entry)() { nullptr };
+
+	alarm_pool_t* timerPool() {
+		return get_core_num() == 1 && core1Pool ? core1Pool : alarm_pool_get_default();
+	}
+
+	std::array<HAL::PWMWrapCallback, NUM_PWM_SLICES> pwmWrapCallbacks {};
+	bool pwmWrapHandlerAdded { false };
+
+	void pwmWrapHandler() {
+		uint32_t status = pwm_get_irq_status_mask();
+		for (uint slice = 0; slice < NUM_PWM_SLICES; ++slice) {
+			if (!(status & (1u << slice))) continue;
+			pwm_clear_irq(slice);
+			if (pwmWrapCallbacks[slice]) pwmWrapCallbacks[slice](slice);
+		}
+	}
+
+	// The data channel fills the ring from the ADC FIFO, then chains to the control channel, which
+	// writes the ring's address back into it and so starts it again.
+	// Paced by PWM, the trigger channel writes a word into the ADC's CS set alias at every wrap of
+	// the slice, START_ONCE on the last of each group of wraps and nothing on the others.  Its own
+	// control channel rearms it from the data channel's, by which time its last START_ONCE has
+	// been converted and it has stopped.
+	int adcDataDMA { -1 };
+	int adcControlDMA { -1 };
+	int adcTriggerDMA { -1 };
+	int adcTriggerControlDMA { -1 };
+	uint16_t* adcRing { nullptr };		// Read by the control channel.
+	size_t adcRingSamples { 0 };
+	uint32_t adcTriggerCount { 0 };		// Read by the trigger's control channel.
+	constexpr float ADC_CLOCK_HZ { 48'000'000.0f };
+	constexpr uint ADC_MAX_WRAPS { 16 };
+	alignas(ADC_MAX_WRAPS * 4) std::array<uint32_t, ADC_MAX_WRAPS> adcTriggerWords {};
+
+
+	void adcSetup(uint32_t channelMask) {
+
+		HAL::adcStopCapture();
+		adc_init();
+		for (uint channel = 0; channel < HAL::ADC_CHANNELS; ++channel) {
+			if (channelMask & (1u << channel)) adc_gpio_init(HAL::ADC_FIRST_PIN + channel);
+		}
+		adc_select_input(__builtin_ctz(channelMask));	// Round robin carries on from the selected input.
+		adc_set_round_robin(channelMask);
+		adc_fifo_setup(true, true, 1, false, false);
+
+		if (adcDataDMA < 0) {
+			adcDataDMA = dma_claim_unused_channel(true);
+			adcControlDMA = dma_claim_unused_channel(true);
+		}
+	}
+
+
+	// chainTo is the control channel's, itself for none.
+	void adcStartDMA(uint16_t* ring, size_t samples, uint chainTo) {
+
+		adcRing = ring;
+		adcRingSamples = samples;
+
+		auto data = dma_channel_get_default_config(adcDataDMA);
+		channel_config_set_transfer_data_size(&data, DMA_SIZE_16);
+		channel_config_set_read_increment(&data, false);
+		channel_config_set_write_increment(&data, true);
+		channel_config_set_dreq(&data, DREQ_ADC);
+		channel_config_set_chain_to(&data, adcControlDMA);
+		dma_channel_configure(adcDataDMA, &data, ring, &adc_hw->fifo, samples, false);
+
+		// Writing the trigger alias restarts the data channel and reloads its count.
+		auto control = dma_channel_get_default_config(adcControlDMA);
+		channel_config_set_transfer_data_size(&control, DMA_SIZE_32);
+		channel_config_set_read_increment(&control, false);
+		channel_config_set_write_increment(&control, false);
+		channel_config_set_chain_to(&control, chainTo);
+		dma_channel_configure(adcControlDMA, &control, &dma_hw->ch[adcDataDMA].al2_write_addr_trig, &adcRing, 1, false);
+
+		dma_channel_start(adcDataDMA);
+	}
+
+
+	void adcUnchain(int channel) {
+
+		if (channel < 0) return;
+		auto config = dma_get_channel_config(channel);
+		channel_config_set_chain_to(&config, channel);
+		dma_channel_set_config(channel, &config, false);
+	}
+
+	void core1Main() {
+		flash_safe_execute_core_init();		// So core 0 can park it while the flash is written.
+		core1Entry();
+		while (true) __wfi();
+	}
+
+	int displayDMA { -1 };
+	volatile bool displayTransferBusy { false };
+	HAL::TransferDone displayTransferDone { nullptr };
+	void* displayTransferContext { nullptr };
+
+
+	void finishDisplayTransfer() {
+		i2c_get_hw(i2c1)->intr_mask = 0;
+		displayTransferBusy = false;
+		if (displayTransferDone) displayTransferDone(displayTransferContext);
+	}
+
+
+	// The DMA is done once the last word is in the TX FIFO, which still has to drain.
+	// Switch to the I2C interrupt to see the final STOP go out.
+	void displayDMAHandler() {
+		if (displayDMA < 0 || !dma_channel_get_irq0_status(displayDMA)) return;
+		dma_channel_acknowledge_irq0(displayDMA);
+		i2c_get_hw(i2c1)->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+	}
+
+
+	void displayI2CHandler() {
+		auto hw = i2c_get_hw(i2c1);
+		if (hw->intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+			dma_channel_abort(displayDMA);
+			hw->clr_tx_abrt;
+			finishDisplayTransfer();
+		} else if (hw->intr_stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+			hw->clr_stop_det;
+			// Every window ends in a STOP, only the one with nothing left behind it counts.
+			bool drained = hw->txflr == 0 && !(hw->status & I2C_IC_STATUS_MST_ACTIVITY_BITS);
+			if (drained && !dma_channel_is_busy(displayDMA)) finishDisplayTransfer();
+		}
+	}
+
+
+	void initDisplayDMA() {
+		displayDMA = dma_claim_unused_channel(true);
+		auto config = dma_channel_get_default_config(displayDMA);
+		channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+		channel_config_set_read_increment(&config, true);
+		channel_config_set_write_increment(&config, false);
+		channel_config_set_dreq(&config, DREQ_I2C1_TX);
+		dma_channel_configure(displayDMA, &config, &i2c_get_hw(i2c1)->data_cmd, nullptr, 0, false);
+
+		dma_channel_set_irq0_enabled(displayDMA, true);
+		irq_add_shared_handler(DMA_IRQ_0, displayDMAHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+		irq_set_enabled(DMA_IRQ_0, true);
+		irq_set_exclusive_handler(I2C1_IRQ, displayI2CHandler);
+		irq_set_enabled(I2C1_IRQ, true);
+	}
+}
+
+
+// System
+
+void HAL::stdioInit() { stdio_init_all(); }
+
+uint64_t HAL::timeUs() { return time_us_64(); }
+
+void HAL::sleepMs(uint32_t ms) { sleep_ms(ms); }
+
+void HAL::busyWaitMs(uint32_t ms) { busy_wait_ms(ms); }
+
+void HAL::idle() { tight_loop_contents(); }
+
+
+// With SEVONPEND an interrupt pending sets the event register, even one taken before the WFE, so
+// the WFE returns at once.  The timeout is an alarm from the default pool, which sends an event.
+void HAL::sleepUntil(uint64_t us) {
+
+	scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS;
+	best_effort_wfe_or_timeout(from_us_since_boot(us));
+}
+
+uint32_t HAL::disableInterrupts() { return save_and_disable_interrupts(); }
+
+void HAL::restoreInterrupts(uint32_t state) { restore_interrupts(state); }
+
+
+// Console
+
+int HAL::consoleRead() {
+	int c = getchar_timeout_us(0);
+	return c == PICO_ERROR_TIMEOUT ? -1 : c;
+}
+
+void HAL::consoleWrite(const char* text, size_t bytes) {
+	for (size_t i = 0; i < bytes; ++i) putchar_raw(text[i]);
+}
+
+namespace {
+	void (*consoleInputCallback)() { nullptr };
+	void consoleCharsAvailable(void*) { if (consoleInputCallback) consoleInputCallback(); }
+}
+
+void HAL::consoleSetInputCallback(void (*callback)()) {
+	consoleInputCallback = callback;
+	stdio_set_chars_available_callback(callback ? consoleCharsAvailable : nullptr, nullptr);
+}
+
+
+// Cores
+
+void HAL::launchCore1(void (*entry)()) {
+	core1Entry = entry;
+	multicore_launch_core1(core1Main);
+}
+
+void HAL::timerInitCore() {
+	if (get_core_num() == 1 && !core1Pool) core1Pool = alarm_pool_create(CORE1_HARDWARE_ALARM, CORE1_MAX_TIMERS);
+}
+
+
+// GPIO
+
+void HAL::gpioInitInput(uint pin) { gpio_set_dir(pin, false); }
+
+bool HAL::gpioGet(uint pin) { return gpio_get(pin); }
+
+uint32_t HAL::gpioGetAll() { return gpio_get_all(); }
+
+void HAL::gpioInitOutput(uint pin) {
+	gpio_init(pin);
+	gpio_set_dir(pin, true);
+}
+
+#ifdef TEC_IRQ_LATENCY
+namespace { std::array<uint64_t, HAL::NUM_GPIOS> edgeUs {}; }
+
+void HAL::gpioPut(uint pin, bool level) {
+	edgeUs[pin] = time_us_64();
+	gpio_put(pin, level);
+}
+
+uint64_t HAL::gpioEdgeUs(uint pin) { return pin < NUM_GPIOS ? edgeUs[pin] : 0; }
+#else
+void HAL::gpioPut(uint pin, bool level) { gpio_put(pin, level); }
+
+uint64_t HAL::gpioEdgeUs(uint pin) { return 0; }
+#endif
+
+void HAL::gpioSetIrqEnabled(uint pin, uint32_t events, bool enabled) {
+	gpio_set_irq_enabled(pin, events, enabled);
+}
+
+void HAL::gpioSetIrqEnabledWithCallback(uint pin, uint32_t events, bool enabled, GPIOCallback callback) {
+	gpio_set_irq_enabled_with_callback(pin, events, enabled, callback);
+}
+
+
+// Timers
+
+bool HAL::addRepeatingTimerMs(int32_t ms, RepeatingTimerCallback callback, void* userData, RepeatingTimer* out) {
+	return alarm_pool_add_repeating_timer_ms(timerPool(), ms, callback, userData, out);
+}
+
+bool HAL::addRepeatingTimerUs(int64_t us, RepeatingTimerCallback callback, void* userData, RepeatingTimer* out) {
+	return alarm_pool_add_repeating_timer_us(timerPool(), us, callback, userData, out);
+}
+
+bool HAL::cancelRepeatingTimer(RepeatingTimer* timer) { return cancel_repeating_timer(timer); }
+
+HAL::AlarmID HAL::addAlarmInMs(uint32_t ms, AlarmCallback callback, void* userData) {
+	return alarm_pool_add_alarm_in_ms(timerPool(), ms, callback, userData, true);
+}
+
+bool HAL::cancelAlarm(AlarmID id) { return alarm_pool_cancel_alarm(timerPool(), id); }
+
+
+// PWM
+
+void HAL::pwmInitPin(uint pin) {
+	gpio_set_function(pin, GPIO_FUNC_PWM);
+	gpio_set_drive_strength(pin, GPIO_DRIVE_STRENGTH_8MA);
+}
+
+uint HAL::pwmSliceForPin(uint pin) { return pwm_gpio_to_slice_num(pin); }
+
+void HAL::pwmSetWrap(uint slice, uint16_t wrap) { pwm_set_wrap(slice, wrap); }
+
+void HAL::pwmSetOutputPolarity(uint slice, bool invertA, bool invertB) { pwm_set_output_polarity(slice, invertA, invertB); }
+
+void HAL::pwmSetPhaseCorrect(uint slice, bool phaseCorrect) { pwm_set_phase_correct(slice, phaseCorrect); }
+
+void HAL::pwmSetBothLevels(uint slice, uint16_t levelA, uint16_t levelB) { pwm_set_both_levels(slice, levelA, levelB); }
+
+void HAL::pwmSetEnabled(uint slice, bool enabled) { pwm_set_enabled(slice, enabled); }
+
+// The NVIC side is per core, so this takes the interrupt on the core that calls it.
+void HAL::pwmSetWrapIrq(uint slice, bool enabled, PWMWrapCallback callback) {
+
+	if (enabled) pwmWrapCallbacks[slice] = callback;
+	pwm_clear_irq(slice);	// The flag is set at every wrap, enabled or not.
+	pwm_set_irq_enabled(slice, enabled);
+	if (enabled && !pwmWrapHandlerAdded) {
+		irq_add_shared_handler(PWM_IRQ_WRAP, pwmWrapHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+		irq_set_enabled(PWM_IRQ_WRAP, true);
+		pwmWrapHandlerAdded = true;
+	}
+}
+
+
+// ADC
+
+void HAL::adcInit(uint channel) {
+	adc_init();		// Only resets and enables the block, fine to repeat.
+	adc_gpio_init(ADC_FIRST_PIN + channel);
+}
+
+uint16_t HAL::adcRead(uint channel) {
+	adc_select_input(channel);
+	return adc_read();
+}
+
+
+void HAL::adcStartCapture(uint32_t channelMask, uint32_t sampleRateHz, uint16_t* ring, size_t samples) {
+
+	adcSetup(channelMask);
+	adc_set_clkdiv(ADC_CLOCK_HZ / sampleRateHz - 1);	// A conversion every clkdiv + 1 cycles.
+	adcStartDMA(ring, samples, adcControlDMA);
+	adc_run(true);
+}
+
+
+void HAL::adcStartCaptureOnPwmWrap(uint32_t channelMask, uint slice, uint wraps, uint16_t* ring, size_t samples) {
+
+	adcSetup(channelMask);
+	adc_set_clkdiv(0);		// As fast as it goes once started, 2 us.
+	if (adcTriggerDMA < 0) {
+		adcTriggerDMA = dma_claim_unused_channel(true);
+		adcTriggerControlDMA = dma_claim_unused_channel(true);
+	}
+
+	adcTriggerWords.fill(0);
+	adcTriggerWords[wraps - 1] = ADC_CS_START_ONCE_BITS;
+	adcTriggerCount = samples * wraps;
+
+	auto trigger = dma_channel_get_default_config(adcTriggerDMA);
+	channel_config_set_transfer_data_size(&trigger, DMA_SIZE_32);
+	channel_config_set_read_increment(&trigger, true);
+	channel_config_set_ring(&trigger, false, __builtin_ctz(wraps * 4));
+	channel_config_set_write_increment(&trigger, false);
+	channel_config_set_dreq(&trigger, pwm_get_dreq(slice));
+	dma_channel_configure(adcTriggerDMA, &trigger, hw_set_alias(&adc_hw->cs), adcTriggerWords.data(), adcTriggerCount, false);
+
+	auto control = dma_channel_get_default_config(adcTriggerControlDMA);
+	channel_config_set_transfer_data_size(&control, DMA_SIZE_32);
+	channel_config_set_read_increment(&control, false);
+	channel_config_set_write_increment(&control, false);
+	dma_channel_configure(adcTriggerControlDMA, &control, &dma_hw->ch[adcTriggerDMA].al1_transfer_count_trig, &adcTriggerCount, 1, false);
+
+	adcStartDMA(ring, samples, adcTriggerControlDMA);
+	dma_channel_start(adcTriggerDMA);
+}
+
+
+void HAL::adcStopCapture() {
+
+	if (!adcRing) return;
+	adc_run(false);
+
+	// Unchain first, or the control channels could start the others again.
+	adcUnchain(adcDataDMA);
+	adcUnchain(adcControlDMA);
+	for (auto channel : { adcTriggerDMA, adcTriggerControlDMA, adcControlDMA, adcDataDMA }) {
+		if (channel >= 0) dma_channel_abort(channel);
+	}
+
+	adc_set_round_robin(0);
+	adc_fifo_setup(false, false, 0, false, false);
+	adc_fifo_drain();
+	adcRing = nullptr;
+}
+
+
+// Between the data channel finishing and the control channel restarting it, the address is one
+// past the end.
+size_t HAL::adcCaptureIndex() {
+
+	if (!adcRing) return 0;
+	size_t index = reinterpret_cast<uint16_t*>(dma_hw->ch[adcDataDMA].write_addr) - adcRing;
+	return index < adcRingSamples ? index : 0;
+}
+
+
+// Flash
+
+namespace {
+
+	constexpr uint32_t FLASH_STORE_OFFSET { PICO_FLASH_SIZE_BYTES - HAL::FLASH_STORE_BYTES };
+	constexpr uint32_t FLASH_TIMEOUT_MS { 100 };	// For core 1 to park.
+
+	struct FlashOperation {
+		uint32_t offset;		// From the start of flash.
+		const uint8_t* page;
+	};
+
+	// Run with core 1 parked and interrupts off, from RAM.
+	void eraseSector(void* operation) {
+		flash_range_erase(static_cast<FlashOperation*>(operation)->offset, FLASH_SECTOR_SIZE);
+	}
+
+	void programPage(void* operation) {
+		auto op = static_cast<FlashOperation*>(operation);
+		flash_range_program(op->offset, op->page, FLASH_PAGE_SIZE);
+	}
+
+	bool storeClearOfImage() { return reinterpret_cast<uintptr_t>(&__flash_binary_end) <= XIP_BASE + FLASH_STORE_OFFSET; }
+}
+
+
+const uint8_t* HAL::flashStore() { return reinterpret_cast<const uint8_t*>(XIP_BASE + FLASH_STORE_OFFSET); }
+
+
+bool HAL::flashErase(uint32_t offset) {
+
+	if (!storeClearOfImage() || offset % FLASH_SECTOR_SIZE || offset >= FLASH_STORE_BYTES) return false;
+	FlashOperation op { FLASH_STORE_OFFSET + offset, nullptr };
+	return flash_safe_execute(eraseSector, &op, FLASH_TIMEOUT_MS) == PICO_OK;
+}
+
+
+bool HAL::flashProgram(uint32_t offset, const uint8_t* page) {
+
+	if (!storeClearOfImage() || offset % FLASH_PAGE_SIZE || offset >= FLASH_STORE_BYTES) return false;
+	FlashOperation op { FLASH_STORE_OFFSET + offset, page };
+	return flash_safe_execute(programPage, &op, FLASH_TIMEOUT_MS) == PICO_OK;
+}
+
+
+// UART
+
+namespace {
+	int uartDMA { -1 };
+	volatile bool uartTransferBusy { false };
+	HAL::TransferDone uartTransferDone { nullptr };
+	void* uartTransferContext { nullptr };
+
+	// Shares DMA_IRQ_0 with the display, so only takes its own channel's interrupt.
+	void uartDMAHandler() {
+		if (uartDMA < 0 || !dma_channel_get_irq0_status(uartDMA)) return;
+		dma_channel_acknowledge_irq0(uartDMA);
+		uartTransferBusy = false;
+		if (uartTransferDone) uartTransferDone(uartTransferContext);
+	}
+}
+
+
+void HAL::uartInit(uint txPin, uint32_t baud) {
+
+	uart_init(uart1, baud);
+	gpio_set_function(txPin, GPIO_FUNC_UART);
+	if (uartDMA >= 0) return;
+
+	uartDMA = dma_claim_unused_channel(true);
+	auto config = dma_channel_get_default_config(uartDMA);
+	channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+	channel_config_set_read_increment(&config, true);
+	channel_config_set_write_increment(&config, false);
+	channel_config_set_dreq(&config, uart_get_dreq(uart1, true));
+	dma_channel_configure(uartDMA, &config, &uart_get_hw(uart1)->dr, nullptr, 0, false);
+
+	dma_channel_set_irq0_enabled(uartDMA, true);
+	irq_add_shared_handler(DMA_IRQ_0, uartDMAHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+	irq_set_enabled(DMA_IRQ_0, true);
+}
+
+
+void HAL::uartWriteAsync(const uint8_t* data, size_t bytes, TransferDone done, void* context) {
+
+	uartTransferBusy = true;
+	uartTransferDone = done;
+	uartTransferContext = context;
+	dma_channel_transfer_from_buffer_now(uartDMA, data, bytes);
+}
+
+
+bool HAL::uartBusy() { return uartTransferBusy; }
+
+
+// I2C
+
+void HAL::i2cInit(uint sdaPin, uint sclPin, uint32_t freq) {
+	i2c_init(i2c1, freq);
+	gpio_pull_up(sdaPin);
+	gpio_pull_up(sclPin);
+	gpio_set_function(sdaPin, GPIO_FUNC_I2C);
+	gpio_set_function(sclPin, GPIO_FUNC_I2C);
+}
+
+
+// Display
+
+void HAL::displayInit() {
+	while ( obdI2CInit(&oled, OLED::_128x64, OLED::ADDRESS, OLED::FLIP_180, OLED::INVERT, OLED::USE_HW_I2C, OLED::SDA_PIN, OLED::SCL_PIN, OLED::RESET_PIN, I2C::I2CFREQ, i2c1) < 0);
+	if (displayDMA < 0) initDisplayDMA();
+	// sometimes oled isn't flipped so flip it again.
+	//if (!oled.flip) oled.flip;
+}
+
+void HAL::displaySetBackBuffer(uint8_t* buffer) { obdSetBackBuffer(&oled, buffer); }
+
+void HAL::displayWriteString(int x, int row, const char* str, int font, bool inverted, bool render) {
+	obdWriteString(&oled, 0, x, row, const_cast<char*>(str), font, inverted, render);
+}
+
+void HAL::displayRectangle(int x1, int y1, int x2, int y2, uint8_t colour, bool filled) {
+	obdRectangle(&oled, x1, y1, x2, y2, colour, filled);
+}
+
+void HAL::displayDumpBuffer(const uint8_t* buffer) { obdDumpBuffer(&oled, const_cast<uint8_t*>(buffer)); }
+
+
+void HAL::displayWriteAsync(const uint16_t* words, size_t count, TransferDone done, void* context) {
+
+	displayTransferBusy = true;
+	displayTransferDone = done;
+	displayTransferContext = context;
+
+	auto hw = i2c_get_hw(i2c1);
+	hw->enable = 0;
+	hw->tar = oled.oled_addr;
+	hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS;
+	hw->enable = 1;
+	hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+	dma_channel_transfer_from_buffer_now(displayDMA, words, count);
+}
+
+
+bool HAL::displayBusy() { return displayTransferBusy; }
@@ -0,0 +1,87 @@
+#include "hbridge.hpp"
+
+#include <algorithm>
+
+
+HBridge::HBridge(const Config& config) :
+			config(config),
+			slice(HAL::pwmSliceForPin(config.pinA)),
+			duty(0),
+			measuring(false),
+			writtenUs(0),
+			latency(),
+			published() {}
+
+
+void HBridge::init() {
+
+	HAL::pwmInitPin(config.pinA);
+	HAL::pwmInitPin(config.pinB);
+
+	HAL::pwmSetWrap(slice, config.wrap);
+	HAL::pwmSetOutputPolarity(slice, true, true);
+	HAL::pwmSetPhaseCorrect(slice, true);
+
+	auto l = levels(0);
+	HAL::pwmSetBothLevels(slice, l.a, l.b);
+	duty = 0;
+	HAL::pwmSetEnabled(slice, true);
+}
+
+
+HBridge::Levels HBridge::levels(int32_t duty) const {
+
+	int32_t wrap = config.wrap;
+	int32_t deadLow = config.deadCycles / 2;
+	int32_t deadHigh = config.deadCycles - deadLow;
+	int32_t minPulse = config.minPulseCycles;
+
+	duty = std::clamp(duty, -DUTY_MAX, DUTY_MAX);
+	// Unsigned, a full wrap times full cooling is up to 65535 * 65534, past INT32_MAX.  It still
+	// fits 32 bits, which keeps the division off the 64 bit library call.
+	static_assert(uint64_t(UINT16_MAX) * (2 * DUTY_MAX) <= UINT32_MAX);
+	int32_t mid = static_cast<uint32_t>(wrap) * static_cast<uint32_t>(DUTY_MAX - duty) / (2 * DUTY_MAX);
+
+	// Low side on below mid - deadLow, high side above mid + deadHigh.
+	int32_t lowest = deadLow + minPulse;
+	int32_t highest = wrap - deadHigh - minPulse;
+	mid = lowest <= highest ? std::clamp(mid, lowest, highest) : wrap / 2;
+	return Levels { static_cast<uint16_t>(mid + deadHigh), static_cast<uint16_t>(mid - deadLow) };
+}
+
+
+void HBridge::set(int32_t duty) {
+
+	auto l = levels(duty);
+	this->duty = std::clamp(duty, -DUTY_MAX, DUTY_MAX);
+	HAL::pwmSetBothLevels(slice, l.a, l.b);
+
+	if (measuring) {
+		writtenUs = HAL::timeUs();
+		HAL::pwmSetWrapIrq(slice, true, wrapped);
+	}
+}
+
+
+// Once per set() while measuring, at the wrap that latched it.
+void HBridge::wrapped(uint slice) {
+
+	auto bridge = wrapOwners[slice];
+	HAL::pwmSetWrapIrq(slice, false, nullptr);
+	if (!bridge) return;
+
+	uint32_t us = HAL::timeUs() - bridge->writtenUs;
+	++bridge->latency.updates;
+	bridge->latency.maxUs = std::max(bridge->latency.maxUs, us);
+	bridge->latency.totalUs += us;
+	bridge->published.write(bridge->latency);
+}
+
+
+void HBridge::measureLatency(bool on) {
+
+	wrapOwners[slice % 8] = on ? this : nullptr;
+	measuring = on;
+	if (!on) HAL::pwmSetWrapIrq(slice, false, nullptr);
+}
+
@@ -0,0 +1,72 @@
+#ifndef _HBRIDGE_HPP__
+#define _HBRIDGE_HPP__
+
+// The TEC's H-bridge on one phase correct PWM slice.  Channel A drives the high side, on while the
+// counter is above levelA.  Channel B drives the low side, on while the counter is below levelB.
+// The dead time sits between the two levels, so it is kept whatever the duty.
+//
+// Both levels go out in one register write, which the RP2040 holds until the counter wraps, so a
+// new duty always starts on a period boundary and A and B can never come from different updates.
+// Direction is only ever in the levels.  The polarity register isn't double buffered, it is set
+// once at init and never touched again.
+
+#include "hal.hpp"
+#include "seqlock.hpp"
+
+
+class HBridge {
+
+public:
+	static constexpr int32_t DUTY_MAX { 32767 };	// Q15.  + heats, - cools.
+
+	struct Config {
+		uint8_t pinA;
+		uint8_t pinB;
+		uint16_t wrap;
+		uint16_t deadCycles;		// Between one side turning off and the other turning on.
+		uint16_t minPulseCycles;	// Neither side is on for less, so neither is on all the time.
+	};
+
+	struct Levels {
+		uint16_t a;
+		uint16_t b;
+	};
+
+	// From set() to the wrap that put it into effect.
+	struct LatencyStats {
+		uint32_t updates;
+		uint32_t maxUs;
+		uint64_t totalUs;
+	};
+
+private:
+	const Config config;
+	const uint slice;
+	volatile int32_t duty;
+
+	bool measuring;
+	volatile uint64_t writtenUs;
+	LatencyStats latency;
+	SeqLock<LatencyStats> published;	// For the other core.
+
+	inline static HBridge* wrapOwners[8] {};
+	static void wrapped(uint slice);
+
+public:
+	HBridge(const Config& config);
+
+	void init();				// Sets up the slice and starts it at zero duty.
+
+	// Takes effect at the next wrap.  Clamped so each side's pulse stays within
+	// minPulseCycles and wrap - deadCycles - minPulseCycles.
+	void set(int32_t duty);
+	int32_t get() const { return duty; }
+	uint getSlice() const { return slice; }
+
+	Levels levels(int32_t duty) const;
+
+	void measureLatency(bool on);
+	LatencyStats getLatency() const { return published.read(); }	// From either core.
+};
+
+#endif // _HBRIDGE_HPP__
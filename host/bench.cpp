@@ -0,0 +1,399 @@
+// Host benchmarks of the firmware's hot paths, against what they replaced.
+//
+//   TEC_Controller_bench [name ...]
+//
+// Runs the named ones, or all of them.  Times are wall clock on the host, so compare the lines of
+// one run with each other rather than with the target.
+//
+// pty talks to a console over a serial device, the simulation's pty or a board's adapter, named
+// by TEC_BENCH_CONSOLE.  Start the simulation with TEC_CONSOLE=pty and a script that keeps it
+// running, some W's, and it prints the pty's name.  Without the variable pty is skipped.
+
+#include "main.hpp"
+#include "menu.hpp"
+#include "display.hpp"
+#include "adc.hpp"
+#include "console.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+namespace {
+
+	// Keeps the compiler from throwing away work whose result isn't otherwise used.
+	volatile uint64_t sink;
+
+	// Nanoseconds per call of body(i) over count calls.
+	template <typename Body>
+	double timeNs(uint count, Body&& body) {
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint i = 0; i < count; ++i) body(i);
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(end - start).count() / count;
+	}
+
+
+// format: MenuSetting values, Format::rightAligned against the stringstream it replaced.
+
+	constexpr uint FORMAT_VALUES { 1'000'000 };
+
+	// What MenuSetting::align did before, into a line of the same width.
+	template <typename T>
+	void streamFormat(char* line, uint width, T value, bool showSign, uint8_t decimals) {
+
+		std::stringstream stream;
+		if (showSign) stream << std::showpos;
+		stream << std::fixed << std::setprecision(decimals) << value << std::endl;
+		std::string text;
+		stream >> text;
+		std::memset(line, ' ', width);
+		if (text.length() <= width) std::memcpy(line + width - text.length(), text.data(), text.length());
+	}
+
+
+	void format() {
+
+		char line[MenuUtils::MAX_COLUMNS + 1] {};
+		constexpr uint WIDTH { 10 };
+
+		double streamInt = timeNs(FORMAT_VALUES, [&line](uint i){ streamFormat(line, WIDTH, static_cast<int>(i) - 500'000, true, 0); sink += line[WIDTH - 1]; });
+		double fastInt = timeNs(FORMAT_VALUES, [&line](uint i){ Format::rightAligned(line, WIDTH, static_cast<int>(i) - 500'000, true, 0); sink += line[WIDTH - 1]; });
+		double streamDouble = timeNs(FORMAT_VALUES, [&line](uint i){ streamFormat(line, WIDTH, i * 0.013 - 6'500, false, 2); sink += line[WIDTH - 1]; });
+		double fastDouble = timeNs(FORMAT_VALUES, [&line](uint i){ Format::rightAligned(line, WIDTH, i * 0.013 - 6'500, false, 2); sink += line[WIDTH - 1]; });
+
+		std::printf("format: int, stringstream %.0f ns, rightAligned %.0f ns\n", streamInt, fastInt);
+		std::printf("format: double to 2 places, stringstream %.0f ns, rightAligned %.0f ns\n", streamDouble, fastDouble);
+
+		// The whole redraw of a changed setting: align() formats it, then the menu draws it.
+		int speed = 0;
+		double height = 0;
+		MenuTitle title { "BENCH" };
+		MenuSetting<int> speedItem { "Spd:", speed, -1'000'000, 1'000'000, true };
+		MenuSetting<double> heightItem { "Hgt:", height, -10'000, 10'000, false, 2 };
+		BasicMenuItem* const items[] { &title, &speedItem, &heightItem };
+		NullDisplay display;
+		Menu<NullDisplay> menu { display, items, 128, 64, 8, 8, HAL::FONT_8x8 };
+		menu.open();
+
+		double refreshInt = timeNs(FORMAT_VALUES, [&](uint i){
+			speed = static_cast<int>(i) - 500'000;
+			speedItem.markDirty();
+			menu.refresh();
+			sink += speedItem.getContent()[0];
+		});
+		double refreshDouble = timeNs(FORMAT_VALUES, [&](uint i){
+			height = i * 0.013 - 6'500;
+			heightItem.markDirty();
+			menu.refresh();
+			sink += heightItem.getContent()[0];
+		});
+		std::printf("format: menu refresh of a changed setting on NullDisplay, int %.0f ns, double %.0f ns\n", refreshInt, refreshDouble);
+	}
+
+
+// fixed: Fixed<15, 16>, the gains' type, against the double it stands in for.  The host has an FPU
+// and the M0+ hasn't, so this only says Fixed is in the same range; there every double operation
+// is a library call.
+
+	constexpr uint FIXED_VALUES { 1'000'000 };
+
+	template <typename T>
+	double fixedOps() {
+
+		T total {};
+		double ns = timeNs(FIXED_VALUES, [&total](uint i){
+			T a = T(static_cast<int>(i % 2'000) - 1'000) / T(7);
+			T b = T(static_cast<int>(i % 97));
+			total += a * b - a / (b + T(3));
+		});
+		if constexpr (std::is_same_v<T, double>) sink += static_cast<int64_t>(total);
+		else sink += total.raw();
+		return ns;
+	}
+
+
+	void fixed() {
+		std::printf("fixed: a * b - a / (b + 3), Fixed<15, 16> %.1f ns, double %.1f ns\n", fixedOps<CONTROL::Gain>(), fixedOps<double>());
+	}
+
+
+// thermistor: Thermistor::Table::milliC, the lookup main.cpp reads the sensor through, against the
+// reference() formula it was built from.  On the M0+ the formula's doubles and log() would be
+// library calls.
+
+	constexpr uint THERMISTOR_READINGS { 10'000'000 };
+	using ThermistorTable = Thermistor::Table<SENSOR::THERMISTOR, 16>;		// The decimated ADC's Q12.4, as main.cpp.
+
+
+	void thermistor() {
+
+		// Scattered over the whole range, so the table isn't read in order.
+		auto reading = [](uint i){ return (i * 40'503u) & UINT16_MAX; };
+		double table = timeNs(THERMISTOR_READINGS, [&](uint i){ sink += ThermistorTable::milliC(reading(i)); });
+		double reference = timeNs(THERMISTOR_READINGS, [&](uint i){ sink += ThermistorTable::reference(reading(i) / 65'536.0); });
+		std::printf("thermistor: milliC %.1f ns, reference %.1f ns, %u points\n", table, reference, ThermistorTable::POINTS);
+	}
+
+
+// adc: AdcCapture::poll() on the firmware's channels, CIC and rate, fed a control tick of samples
+// at a time.  Its own Stats say how long it took.
+
+	constexpr uint ADC_POLLS { 200'000 };
+	constexpr uint ADC_SAMPLES_PER_POLL { static_cast<uint>(CONSTANT::PWM_FREQ) / SENSOR::PWM_WRAPS_PER_SAMPLE / CONTROL::RATE_HZ };
+
+	using SensorADC = AdcCapture<SENSOR::RING_SAMPLES, SENSOR::CIC_ORDER, SENSOR::DECIMATION>;		// As main.cpp.
+
+	// Stands in for the DMA.
+	uint16_t* adcRing;
+	size_t adcRingSamples;
+	size_t adcIndex;
+
+
+	void adc() {
+
+		// Something like the sensors give, a slow sine each with a few counts of noise.
+		std::array<uint16_t, 4'096> wave;
+		uint32_t noise = 1;
+		for (uint i = 0; i < wave.size(); ++i) {
+			noise = noise * 1'664'525 + 1'013'904'223;
+			wave[i] = 2'048 + std::lround(1'500 * std::sin(i * 2 * M_PI / wave.size())) + (noise >> 29) - 4;
+		}
+
+		SensorADC capture;
+		capture.startOnPwm(SENSOR::CHANNEL_MASK, 0, SENSOR::PWM_WRAPS_PER_SAMPLE, CONSTANT::PWM_FREQ);
+		uint outputs = 0;
+		uint at = 0;
+		for (uint i = 0; i < ADC_POLLS; ++i) {
+			for (uint n = 0; n < ADC_SAMPLES_PER_POLL; ++n) {
+				adcRing[adcIndex] = wave[at++ % wave.size()];
+				if (++adcIndex == adcRingSamples) adcIndex = 0;
+			}
+			outputs += capture.poll();
+		}
+		capture.stop();
+		sink += outputs + capture.value(SENSOR::TEMPERATURE_CHANNEL);
+
+		auto stats = capture.getStats();
+		double nsPerSample = stats.busyUs * 1'000.0 / stats.samples;
+		double rate = CONSTANT::PWM_FREQ / SENSOR::PWM_WRAPS_PER_SAMPLE;
+		std::printf("adc: %u channels, CIC order %u / %u, %u samples a poll\n", SENSOR::CHANNELS, SENSOR::CIC_ORDER, SENSOR::DECIMATION, ADC_SAMPLES_PER_POLL);
+		std::printf("adc: samples %llu, outputs %u, busyUs %llu, elapsedUs %llu\n", static_cast<unsigned long long>(stats.samples), stats.outputs,
+					static_cast<unsigned long long>(stats.busyUs), static_cast<unsigned long long>(stats.elapsedUs));
+		std::printf("adc: %.2f ns a sample, %.2f %% of a core at %.0f ksps\n", nsPerSample, nsPerSample * rate / 1e7, rate / 1'000);
+	}
+
+
+// console: Console::execute() on single and chained lines, and service() taking them a character
+// at a time, with the firmware's headers in front of handlers that only keep the values.
+
+	constexpr uint CONSOLE_LINES { 1'000'000 };
+
+	Console::Number benchGain;
+	int benchSetpoint;
+
+	void benchSetNumber(const Console::Args& args, Console::Reply& reply) {
+		if (!args.number(0, benchGain)) reply.error("bad number");
+	}
+	void benchNumber(const Console::Args&, Console::Reply& reply) { reply.add(benchGain, 3); }
+	void benchSetSetpoint(const Console::Args& args, Console::Reply& reply) {
+		Console::Number value;
+		if (!args.number(0, value)) reply.error("bad number");
+		else benchSetpoint = value.round();
+	}
+	void benchSetpointQuery(const Console::Args&, Console::Reply& reply) { reply.add(benchSetpoint); }
+	void benchText(const Console::Args&, Console::Reply& reply) { reply.add("TEC,BENCH,0,0"); }
+	void benchStatus(const Console::Args&, Console::Reply& reply) {
+		reply.add(1'000'000);
+		reply.add(",0,");
+		reply.add(12);
+		reply.add(",");
+		reply.add(40);
+	}
+
+	// As main.cpp's table, in the same order.
+	const Console::Command consoleTable[] {
+		{ "*IDN", nullptr, benchText },
+		{ "MEASure:TEMPerature", nullptr, benchNumber },
+		{ "MEASure:OUTPut", nullptr, benchNumber },
+		{ "TEMPerature:SETpoint", benchSetSetpoint, benchSetpointQuery },
+		{ "PID:KP", benchSetNumber, benchNumber },
+		{ "PID:KI", benchSetNumber, benchNumber },
+		{ "PID:KD", benchSetNumber, benchNumber },
+		{ "PID:DFILter", benchSetNumber, benchNumber },
+		{ "PID:TUNE", nullptr, benchText },
+		{ "STATus:LOOP", nullptr, benchStatus },
+		{ "STATus:IDLE", nullptr, benchStatus },
+		{ "SYSTem:SETTings", nullptr, benchStatus },
+	};
+
+	// Stands in for the UART.
+	const char* consoleInput;
+	size_t consoleAt;
+	size_t consoleReplies;
+
+
+	void console() {
+
+		Console console { consoleTable };
+		const char* const lines[] { "*IDN?", "PID:KP 0.75", "pid:kp?", "STAT:LOOP?", "TEMP:SET 25.0;PID:KI 0.05;MEAS:TEMP?" };
+		for (auto line : lines) {
+			char text[Console::MAX_LINE + 1];
+			size_t length = std::strlen(line) + 1;
+			double ns = timeNs(CONSOLE_LINES, [&](uint){
+				std::memcpy(text, line, length);		// execute() tokenises it in place.
+				sink += console.execute(text).size();
+			});
+			std::printf("console: execute \"%s\" %.0f ns\n", line, ns);
+		}
+
+		// The same lines in turn, through service() as if from the UART.
+		std::string stream;
+		for (auto line : lines) (stream += line) += "\r\n";
+		consoleInput = stream.c_str();
+		consoleAt = 0;
+		consoleReplies = 0;
+		uint services = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (uint i = 0; i < CONSOLE_LINES; ++i) {
+			while (console.service()) ++services;
+			consoleAt = 0;
+		}
+		auto end = std::chrono::steady_clock::now();
+		double ns = std::chrono::duration<double, std::nano>(end - start).count() / (CONSOLE_LINES * std::size(lines));
+		std::printf("console: service, %.0f ns a line, %.1f calls a line, %zu replies\n", ns,
+					static_cast<double>(services) / (CONSOLE_LINES * std::size(lines)), consoleReplies);
+	}
+
+
+// pty: lines a second through a real serial device, one at a time and PTY_WINDOW at a time.
+
+	constexpr double PTY_SECONDS { 2 };
+	constexpr uint PTY_WINDOW { 16 };		// Lines sent ahead of their replies.  The sim drops what its pty won't take.
+	constexpr int PTY_TIMEOUT_MS { 1'000 };
+
+	// Sends "*IDN?" lines, keeping up to window of them unanswered, for PTY_SECONDS.  Returns the
+	// replies a second, or a negative number if the other end stopped answering.
+	double ptyRate(int fd, uint window) {
+
+		const char line[] { "*IDN?\n" };
+		uint64_t sent = 0, replies = 0;
+		auto start = std::chrono::steady_clock::now();
+		auto end = start + std::chrono::duration<double>(PTY_SECONDS);
+		bool sending = true;
+		while (sending || replies < sent) {
+			if (sending && std::chrono::steady_clock::now() >= end) sending = false;
+			while (sending && sent - replies < window) {
+				if (write(fd, line, sizeof(line) - 1) != sizeof(line) - 1) return -1;
+				++sent;
+			}
+			pollfd ready { fd, POLLIN, 0 };
+			if (poll(&ready, 1, PTY_TIMEOUT_MS) <= 0) return -1;
+			char buffer[256];
+			ssize_t got = read(fd, buffer, sizeof(buffer));
+			if (got <= 0) return -1;
+			for (ssize_t i = 0; i < got; ++i) replies += buffer[i] == '\n';
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return replies / seconds;
+	}
+
+
+	void pty() {
+
+		auto name = std::getenv("TEC_BENCH_CONSOLE");
+		if (!name) {
+			std::printf("pty: skipped, TEC_BENCH_CONSOLE isn't set\n");
+			return;
+		}
+		int fd = open(name, O_RDWR | O_NOCTTY);
+		if (fd < 0) {
+			std::printf("pty: can't open %s\n", name);
+			return;
+		}
+		termios raw;
+		tcgetattr(fd, &raw);
+		cfmakeraw(&raw);
+		tcsetattr(fd, TCSANOW, &raw);
+		tcflush(fd, TCIOFLUSH);
+
+		for (uint window : { 1u, PTY_WINDOW }) {
+			double rate = ptyRate(fd, window);
+			if (rate < 0) std::printf("pty: %u at a time, no reply within %d ms\n", window, PTY_TIMEOUT_MS);
+			else std::printf("pty: %u at a time, %.0f lines/s\n", window, rate);
+		}
+		close(fd);
+	}
+
+
+	struct Bench {
+		const char* name;
+		void (*run)();
+	};
+
+	const Bench benches[] {
+		{ "format", format },
+		{ "fixed", fixed },
+		{ "thermistor", thermistor },
+		{ "adc", adc },
+		{ "console", console },
+		{ "pty", pty },
+	};
+}
+
+
+// What AdcCapture needs of the HAL, with a real clock so that its busyUs means something.
+namespace HAL {
+
+	uint64_t timeUs() {
+		using namespace std::chrono;
+		return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	void adcStartCapture(uint32_t, uint32_t, uint16_t* ring, size_t samples) {
+		adcRing = ring;
+		adcRingSamples = samples;
+		adcIndex = 0;
+	}
+
+	void adcStartCaptureOnPwmWrap(uint32_t, uint, uint, uint16_t* ring, size_t samples) {
+		adcStartCapture(0, 0, ring, samples);
+	}
+
+	void adcStopCapture() {}
+	size_t adcCaptureIndex() { return adcIndex; }
+
+	int consoleRead() {
+		char c = consoleInput[consoleAt];
+		if (!c) return -1;
+		++consoleAt;
+		return static_cast<uint8_t>(c);
+	}
+
+	void consoleWrite(const char* text, size_t bytes) {
+		consoleReplies += bytes && text[bytes - 1] == '\n';
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+
+	for (auto& bench : benches) {
+		bool wanted = argc < 2;
+		for (int i = 1; i < argc; ++i) wanted |= std::strcmp(argv[i], bench.name) == 0;
+		if (wanted) bench.run();
+	}
+	return 0;
+}
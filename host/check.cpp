@@ -0,0 +1,121 @@
+// Host checks of the firmware's arithmetic against exact references.  ctest runs each one.
+//
+//   TEC_Controller_check [name ...]
+//
+// Runs the named ones, or all of them, and exits nonzero if any failed.
+
+#include "main.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace {
+
+	// Says which one failed, for a check made of several.
+	bool expect(bool ok, const char* what) {
+		if (!ok) std::printf("  failed: %s\n", what);
+		return ok;
+	}
+
+
+// thermistor: the table main.cpp reads the sensor through, against the formula it was built from.
+
+	using ThermistorTable = Thermistor::Table<SENSOR::THERMISTOR, 16>;		// The decimated ADC's Q12.4, as main.cpp.
+
+	// Over the range the controller is used in, -20 to 80 C, well inside the 0.1 C it's shown to.
+	constexpr int32_t WORKING_MIN_MILLIC { -20'000 };
+	constexpr int32_t WORKING_MAX_MILLIC { 80'000 };
+	constexpr int32_t WORKING_ERROR_MILLIC { 10 };
+	// Outside it, down to the clamps, where a segment takes in the knee.
+	constexpr int32_t CLAMP_ERROR_MILLIC { 600 };
+
+
+	bool thermistor() {
+
+		int32_t worstWorking = 0, worstClamp = 0;
+		uint32_t atWorking = 0, atClamp = 0;
+		for (uint32_t reading = 0; reading <= UINT16_MAX; ++reading) {
+			int32_t reference = ThermistorTable::reference(reading / 65'536.0);
+			int32_t error = std::abs(ThermistorTable::milliC(reading) - reference);
+			bool working = reference >= WORKING_MIN_MILLIC && reference <= WORKING_MAX_MILLIC;
+			int32_t& worst = working ? worstWorking : worstClamp;
+			if (error > worst) {
+				worst = error;
+				(working ? atWorking : atClamp) = reading;
+			}
+		}
+
+		std::printf("thermistor: -20 to 80 C, worst %d mC at %u, limit %d\n", worstWorking, atWorking, WORKING_ERROR_MILLIC);
+		std::printf("thermistor: elsewhere, worst %d mC at %u, limit %d\n", worstClamp, atClamp, CLAMP_ERROR_MILLIC);
+		return worstWorking <= WORKING_ERROR_MILLIC && worstClamp <= CLAMP_ERROR_MILLIC;
+	}
+
+
+// fixed: Fixed's edge cases, saturation at both ends, rounding and division by zero.
+
+	using Gain = CONTROL::Gain;
+
+	bool fixed() {
+
+		bool ok = true;
+		ok &= expect(Gain(40'000) == Gain::max() && Gain(-40'000) == Gain::min(), "int constructor saturates");
+		ok &= expect(Gain(1e12) == Gain::max() && Gain(-1e12) == Gain::min(), "double constructor saturates");
+		ok &= expect(Gain::fromRaw(Gain::RAW_MAX).raw() == Gain::RAW_MAX && Gain::fromRaw(Gain::RAW_MIN).raw() == Gain::RAW_MIN, "fromRaw keeps RAW_MAX and RAW_MIN");
+		ok &= expect(Gain::max() + Gain::fromRaw(1) == Gain::max() && Gain::min() - Gain::fromRaw(1) == Gain::min(), "+ and - saturate");
+		ok &= expect(Gain::max() * Gain(2) == Gain::max() && Gain::min() * Gain(2) == Gain::min(), "* saturates");
+		ok &= expect(Gain::max() * Gain(-2) == Gain::min() && Gain::min() * Gain(-2) == Gain::max(), "* saturates across the sign");
+		ok &= expect(-Gain::min() == Gain::max() && -Gain::max() == Gain::fromRaw(Gain::RAW_MIN + 1), "negation saturates");
+		ok &= expect(Gain::max() / Gain::fromRaw(1) == Gain::max() && Gain::min() / Gain::fromRaw(1) == Gain::min(), "/ saturates");
+
+		ok &= expect(Gain::ratio(5, 0) == Gain::max() && Gain::ratio(-5, 0) == Gain::min(), "ratio by zero saturates to the numerator's sign");
+		ok &= expect(Gain::ratio(0, 0) == Gain::max(), "ratio 0 / 0 is max");
+		ok &= expect(Gain(1) / Gain(0) == Gain::max() && Gain(-1) / Gain(0) == Gain::min(), "/ by zero saturates");
+
+		// Halves away from zero, in every sign.
+		ok &= expect(Gain::ratio(1, 2 * Gain::ONE).raw() == 1 && Gain::ratio(-1, 2 * Gain::ONE).raw() == -1, "ratio rounds halves away from zero");
+		ok &= expect(Gain::ratio(1, -2 * Gain::ONE).raw() == -1 && Gain::ratio(-1, -2 * Gain::ONE).raw() == 1, "ratio rounds halves away from zero, negative denominator");
+		bool rounded = true;
+		for (int64_t n = -1'000; n <= 1'000; ++n) {
+			for (int64_t d = -300; d <= 300; ++d) {
+				if (d) rounded &= Gain::ratio(n, d * Gain::ONE).raw() == std::round(static_cast<double>(n) / d);
+			}
+		}
+		ok &= expect(rounded, "ratio rounds to nearest, as std::round");
+
+		// Multiplication rounds halves up, towards +infinity.
+		ok &= expect((Gain::fromRaw(1) * Gain(0.5)).raw() == 1 && (Gain::fromRaw(-1) * Gain(0.5)).raw() == 0, "* rounds halves up");
+		ok &= expect(Gain(2.5).round() == 3 && Gain(-2.5).round() == -2, "round() rounds halves up");
+
+		std::printf("fixed: Q%u.%u edge cases\n", Gain::INT_BITS, Gain::FRAC_BITS);
+		return ok;
+	}
+
+
+	struct Check {
+		const char* name;
+		bool (*run)();
+	};
+
+	const Check checks[] {
+		{ "thermistor", thermistor },
+		{ "fixed", fixed },
+	};
+}
+
+
+int main(int argc, char* argv[]) {
+
+	bool passed = true;
+	for (auto& check : checks) {
+		bool wanted = argc < 2;
+		for (int i = 1; i < argc; ++i) wanted |= std::strcmp(argv[i], check.name) == 0;
+		if (!wanted) continue;
+		bool ok = check.run();
+		std::printf("%s: %s\n", check.name, ok ? "passed" : "FAILED");
+		passed &= ok;
+	}
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,102 @@
+// Reads the telemetry stream, see telemetry.hpp, and prints a CSV line per frame.
+//
+//   TEC_Controller_telemetry [device or file]
+//
+// From stdin without one.  A serial device is put into raw mode and read until it closes, so the
+// simulation's pty works as well as a USB serial adapter on the board's telemetry pin (set its baud
+// rate first, with stty).  Frames that fail to decode or their CRC, and gaps in the tick count,
+// are counted on stderr at the end.
+
+#include "telemetry.hpp"
+#include "crc.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+
+namespace {
+
+	struct Counts {
+		uint64_t frames;
+		uint64_t bad;			// Not COBS, the wrong length or type, or a CRC error.
+		uint64_t missed;		// Ticks between the frames that arrived.
+	} counts {};
+
+	bool haveTick { false };
+	uint32_t lastTick { 0 };
+
+
+	void frame(const uint8_t* data, size_t bytes) {
+
+		uint8_t decoded[Telemetry::MAX_ENCODED];
+		if (bytes > sizeof(decoded)) {
+			++counts.bad;
+			return;
+		}
+		size_t n = COBS::decode(data, bytes, decoded);
+		if (n != Telemetry::FRAME_BYTES || decoded[0] != Telemetry::SAMPLE_FRAME) {
+			++counts.bad;
+			return;
+		}
+		uint32_t crc;
+		std::memcpy(&crc, &decoded[n - sizeof(crc)], sizeof(crc));
+		if (CRC::crc32(decoded, n - sizeof(crc)) != crc) {
+			++counts.bad;
+			return;
+		}
+
+		Telemetry::Sample sample;
+		std::memcpy(&sample, &decoded[1], sizeof(sample));
+		if (haveTick && sample.tick != lastTick + 1) counts.missed += sample.tick - lastTick - 1;
+		haveTick = true;
+		lastTick = sample.tick;
+		++counts.frames;
+
+		std::printf("%u,%u,%.3f,%.3f,%.4f,%d,%u,%u\n", sample.tick, sample.timeUs, sample.temperature * 1e-3,
+					sample.setpoint * 1e-3, sample.duty / 32767.0, sample.currentMa, sample.execUs, sample.lateUs);
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+
+	int fd = 0;
+	if (argc > 1) {
+		fd = open(argv[1], O_RDONLY | O_NOCTTY);
+		if (fd < 0) {
+			std::perror(argv[1]);
+			return 1;
+		}
+	}
+	termios raw;
+	if (tcgetattr(fd, &raw) == 0) {
+		cfmakeraw(&raw);
+		tcsetattr(fd, TCSANOW, &raw);
+	}
+
+	// Everything up to the first zero may be the end of a frame, so it is skipped.
+	std::printf("tick,time_us,temperature_c,setpoint_c,duty,current_ma,exec_us,late_us\n");
+	std::vector<uint8_t> pending;
+	bool synced = false;
+	uint8_t buffer[4096];
+	ssize_t got;
+	while ((got = read(fd, buffer, sizeof(buffer))) > 0) {		// A pty whose writer has gone is EIO.
+		for (ssize_t i = 0; i < got; ++i) {
+			if (buffer[i]) {
+				pending.push_back(buffer[i]);
+				continue;
+			}
+			if (synced && !pending.empty()) frame(pending.data(), pending.size());
+			synced = true;
+			pending.clear();
+		}
+	}
+
+	std::fprintf(stderr, "telemetry: %llu frames, %llu bad, %llu ticks missed\n", static_cast<unsigned long long>(counts.frames),
+				 static_cast<unsigned long long>(counts.bad), static_cast<unsigned long long>(counts.missed));
+	return 0;
+}
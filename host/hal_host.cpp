@@ -0,0 +1,262 @@
+#include "hal.hpp"
+#include "sim.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+
+namespace {
+
+	uint8_t* backBuffer { nullptr };
+
+	// Timing of a blocking obdWriteString/obdDumpBuffer: set position, then a data run per page.
+	constexpr size_t POSITION_BYTES { 5 };
+
+
+	int64_t repeatingTimerTrampoline(HAL::AlarmID id, void* userData) {
+
+		auto t = static_cast<HAL::RepeatingTimer*>(userData);
+		// Positive delay is measured from the end of the callback, negative from the start.
+		return t->callback(t) ? -t->delayUs : 0;
+	}
+
+
+	void setPixel(uint8_t* buffer, int x, int y, bool on) {
+
+		if (x < 0 || y < 0 || x >= static_cast<int>(Sim::OLED_WIDTH) || y >= static_cast<int>(Sim::OLED_PAGES * 8)) return;
+		auto& byte = buffer[(y / 8) * Sim::OLED_WIDTH + x];
+		if (on) byte |= 1 << (y % 8);
+		else byte &= ~(1 << (y % 8));
+	}
+
+
+	// 12x16 glyphs are the 8x8 pattern doubled vertically and padded to 12 columns.
+	void writeGlyph(uint8_t* buffer, int x, int row, char c, int font, bool inverted) {
+
+		uint8_t g[8];
+		Sim::glyph(c, g);
+		uint8_t flip = inverted ? 0xFF : 0x00;
+
+		if (font != HAL::FONT_12x16) {
+			for (int i = 0; i < 8; ++i) {
+				if (x + i >= 0 && x + i < static_cast<int>(Sim::OLED_WIDTH) && row >= 0 && row < static_cast<int>(Sim::OLED_PAGES))
+					buffer[row * Sim::OLED_WIDTH + x + i] = g[i] ^ flip;
+			}
+			return;
+		}
+
+		for (int i = 0; i < 12; ++i) {
+			uint8_t col = (i >= 2 && i < 10) ? g[i - 2] : 0;
+			uint16_t tall = 0;
+			for (int bit = 0; bit < 8; ++bit) {
+				if (col & (1 << bit)) tall |= 3 << (bit * 2);
+			}
+			tall ^= inverted ? 0xFFFF : 0x0000;
+			for (int half = 0; half < 2; ++half) {
+				if (x + i >= 0 && x + i < static_cast<int>(Sim::OLED_WIDTH) && row + half >= 0 && row + half < static_cast<int>(Sim::OLED_PAGES))
+					buffer[(row + half) * Sim::OLED_WIDTH + x + i] = tall >> (half * 8);
+			}
+		}
+	}
+}
+
+
+// System
+
+void HAL::stdioInit() { std::setvbuf(stdout, nullptr, _IOLBF, 0); }
+
+uint64_t HAL::timeUs() { return Sim::now(); }
+
+void HAL::sleepMs(uint32_t ms) { Sim::advanceUs(ms * 1000ull); }
+
+void HAL::busyWaitMs(uint32_t ms) { Sim::advanceUs(ms * 1000ull); }
+
+void HAL::idle() { Sim::runScript(); }
+
+void HAL::sleepUntil(uint64_t us) { Sim::sleepUntil(us); }
+
+uint32_t HAL::disableInterrupts() { return 0; }	// Simulated interrupts only happen when time advances.
+
+void HAL::restoreInterrupts(uint32_t state) {}
+
+
+// Console
+
+int HAL::consoleRead() { return Sim::consoleRead(); }
+
+void HAL::consoleWrite(const char* text, size_t bytes) { Sim::consoleWrite(text, bytes); }
+
+void HAL::consoleSetInputCallback(void (*callback)()) { Sim::consoleSetInputCallback(callback); }
+
+
+// Cores
+
+void HAL::launchCore1(void (*entry)()) {
+	Sim::setCore(1);
+	entry();
+	Sim::setCore(0);
+}
+
+void HAL::timerInitCore() {}
+
+
+// GPIO
+
+void HAL::gpioInitInput(uint pin) {}
+
+bool HAL::gpioGet(uint pin) { return Sim::getPin(pin); }
+
+uint32_t HAL::gpioGetAll() {
+	uint32_t all = 0;
+	for (uint pin = 0; pin < NUM_GPIOS; ++pin) all |= static_cast<uint32_t>(Sim::getPin(pin)) << pin;
+	return all;
+}
+
+void HAL::gpioInitOutput(uint pin) {}
+
+void HAL::gpioPut(uint pin, bool level) { Sim::setPin(pin, level); }
+
+uint64_t HAL::gpioEdgeUs(uint pin) { return Sim::edgeUs(pin); }
+
+void HAL::gpioSetIrqEnabled(uint pin, uint32_t events, bool enabled) { Sim::setIrqEnabled(pin, events, enabled); }
+
+void HAL::gpioSetIrqEnabledWithCallback(uint pin, uint32_t events, bool enabled, GPIOCallback callback) {
+	Sim::setIrqCallback(callback);
+	Sim::setIrqEnabled(pin, events, enabled);
+}
+
+
+// Timers
+
+bool HAL::addRepeatingTimerMs(int32_t ms, RepeatingTimerCallback callback, void* userData, RepeatingTimer* out) {
+	return addRepeatingTimerUs(ms * 1000ll, callback, userData, out);
+}
+
+bool HAL::addRepeatingTimerUs(int64_t us, RepeatingTimerCallback callback, void* userData, RepeatingTimer* out) {
+
+	out->delayUs = us;
+	out->callback = callback;
+	out->user_data = userData;
+	out->alarmID = Sim::addAlarmUs(us < 0 ? -us : us, repeatingTimerTrampoline, out);
+	return out->alarmID > 0;
+}
+
+bool HAL::cancelRepeatingTimer(RepeatingTimer* timer) { return Sim::cancelAlarm(timer->alarmID); }
+
+HAL::AlarmID HAL::addAlarmInMs(uint32_t ms, AlarmCallback callback, void* userData) {
+	return Sim::addAlarmUs(ms * 1000ull, callback, userData);
+}
+
+bool HAL::cancelAlarm(AlarmID id) { return Sim::cancelAlarm(id); }
+
+
+// PWM.  Slices are numbered as on the RP2040, two pins each.
+
+void HAL::pwmInitPin(uint pin) {}
+
+uint HAL::pwmSliceForPin(uint pin) { return (pin >> 1) & 7; }
+
+void HAL::pwmSetWrap(uint slice, uint16_t wrap) { Sim::pwmSlice(slice).wrap = wrap; }
+
+void HAL::pwmSetOutputPolarity(uint slice, bool invertA, bool invertB) {
+	Sim::pwmSlice(slice).invertA = invertA;
+	Sim::pwmSlice(slice).invertB = invertB;
+}
+
+void HAL::pwmSetPhaseCorrect(uint slice, bool phaseCorrect) { Sim::pwmSlice(slice).phaseCorrect = phaseCorrect; }
+
+void HAL::pwmSetBothLevels(uint slice, uint16_t levelA, uint16_t levelB) { Sim::pwmSetLevels(slice, levelA, levelB); }
+
+void HAL::pwmSetEnabled(uint slice, bool enabled) { Sim::pwmSetEnabled(slice, enabled); }
+
+void HAL::pwmSetWrapIrq(uint slice, bool enabled, PWMWrapCallback callback) { Sim::pwmSetWrapIrq(slice, enabled, callback); }
+
+
+// ADC
+
+void HAL::adcInit(uint channel) {}
+
+uint16_t HAL::adcRead(uint channel) { return Sim::adcRead(channel); }
+
+void HAL::adcStartCapture(uint32_t channelMask, uint32_t sampleRateHz, uint16_t* ring, size_t samples) {
+	Sim::adcStartCapture(channelMask, sampleRateHz, ring, samples);
+}
+
+void HAL::adcStartCaptureOnPwmWrap(uint32_t channelMask, uint slice, uint wraps, uint16_t* ring, size_t samples) {
+	Sim::adcStartCaptureOnPwmWrap(channelMask, slice, wraps, ring, samples);
+}
+
+void HAL::adcStopCapture() { Sim::adcStopCapture(); }
+
+size_t HAL::adcCaptureIndex() { return Sim::adcCaptureIndex(); }
+
+
+// Flash
+
+const uint8_t* HAL::flashStore() { return Sim::flash(); }
+
+bool HAL::flashErase(uint32_t offset) { return Sim::flashErase(offset); }
+
+bool HAL::flashProgram(uint32_t offset, const uint8_t* page) { return Sim::flashProgram(offset, page); }
+
+
+// UART
+
+void HAL::uartInit(uint txPin, uint32_t baud) { Sim::uartInit(baud); }
+
+void HAL::uartWriteAsync(const uint8_t* data, size_t bytes, TransferDone done, void* context) {
+	Sim::uartWriteAsync(data, bytes, done, context);
+}
+
+bool HAL::uartBusy() { return Sim::uartBusy(); }
+
+
+// I2C
+
+void HAL::i2cInit(uint sdaPin, uint sclPin, uint32_t freq) {}
+
+
+// Display
+
+void HAL::displayInit() {
+	std::memset(Sim::oledRam(), 0, Sim::OLED_WIDTH * Sim::OLED_PAGES);
+}
+
+void HAL::displaySetBackBuffer(uint8_t* buffer) { backBuffer = buffer; }
+
+
+void HAL::displayWriteString(int x, int row, const char* str, int font, bool inverted, bool render) {
+
+	bool toPanel = render || !backBuffer;
+	uint columns = 0;
+	for (const char* c = str; *c; ++c) {
+		if (backBuffer) writeGlyph(backBuffer, x + columns, row, *c, font, inverted);
+		if (toPanel) writeGlyph(Sim::oledRam(), x + columns, row, *c, font, inverted);
+		columns += fontWidth(font);
+	}
+	if (toPanel) Sim::i2cTransfer(fontPages(font) * (POSITION_BYTES + columns));
+}
+
+
+void HAL::displayRectangle(int x1, int y1, int x2, int y2, uint8_t colour, bool filled) {
+
+	if (!backBuffer) return;
+	for (int y = y1; y <= y2; ++y) {
+		for (int x = x1; x <= x2; ++x) {
+			if (filled || y == y1 || y == y2 || x == x1 || x == x2) setPixel(backBuffer, x, y, colour != 0);
+		}
+	}
+}
+
+
+void HAL::displayDumpBuffer(const uint8_t* buffer) {
+
+	std::memcpy(Sim::oledRam(), buffer, Sim::OLED_WIDTH * Sim::OLED_PAGES);
+	Sim::i2cTransfer(Sim::OLED_PAGES * (POSITION_BYTES + Sim::OLED_WIDTH));
+}
+
+void HAL::displayWriteAsync(const uint16_t* words, size_t count, TransferDone done, void* context) {
+	Sim::oledWriteAsync(words, count, done, context);
+}
+
+bool HAL::displayBusy() { return Sim::oledBusy(); }
@@ -0,0 +1,1190 @@
+#include "sim.hpp"
+#include "ssd1306.hpp"
+#include "main.hpp"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+namespace {
+
+	struct Alarm {
+		bool used;
+		HAL::AlarmID id;
+		uint64_t due;
+		HAL::AlarmCallback callback;
+		void* userData;
+		uint core;			// Whose interrupt it is.
+	};
+
+	// Peripherals that finish in their own time get a slot after the alarm pool.
+	enum DeviceSlot : uint { DisplayDMA = Sim::NUM_ALARMS, UartDMA, PWMWrap, NumSlots };
+
+	uint64_t clockUs { 0 };
+	uint irqDepth { 0 };	// Non zero while a simulated interrupt is running.  Nothing else preempts it.
+	uint currentCore { 0 };
+	uint64_t core0Interrupts { 0 };		// What wakes core 0 from sleepUntil.
+	bool sleeping { false };
+	uint64_t sleepInterrupts { 0 };		// core0Interrupts when it went to sleep.
+	HAL::AlarmID nextAlarmID { 1 };
+	std::array<Alarm, NumSlots> alarms {};
+
+	std::array<bool, Sim::NUM_PINS> pins {};
+	std::array<uint32_t, Sim::NUM_PINS> pinIrqEvents {};
+	std::array<uint32_t, Sim::NUM_PINS> pinIrqPending {};
+	std::array<uint64_t, Sim::NUM_PINS> pinEdgeUs {};
+	HAL::GPIOCallback gpioCallback { nullptr };
+
+	std::array<Sim::PWMSlice, Sim::NUM_PWM_SLICES> pwmSlices {};
+	constexpr uint64_t PWM_CYCLES_PER_US { Sim::PWM_CLOCK_HZ / 1'000'000 };
+
+	// Conversion k samples at firstCycle + k * strideCycles, or for free running at startCycle plus
+	// k conversion times of the ADC clock.
+	struct AdcCapture {
+		uint16_t* ring;
+		size_t samples;
+		uint32_t rateHz;		// 0 when paced by PWM.
+		uint64_t firstCycle;
+		uint64_t strideCycles;
+		uint64_t taken;			// Samples since the start.
+		std::array<uint8_t, HAL::ADC_CHANNELS> order;
+		uint channels;
+	} adcCapture {};
+	Sim::AdcStats adcTiming {};
+
+	constexpr uint BRIDGE_SLICE { (PIN::PWM_A >> 1) & 7 };
+
+	Sim::Plant plantState { Sim::PLANT_AMBIENT_C, Sim::PLANT_AMBIENT_C, Sim::PLANT_AMBIENT_C, 0 };
+	uint64_t plantUs { 0 };
+
+	// The plate every RESPONSE_STEP_US since the mark.
+	constexpr uint64_t RESPONSE_STEP_US { 10'000 };
+	std::vector<double> responseC;
+	uint64_t responseUs { 0 };
+	bool responseMarked { false };
+	uint32_t noiseSeed { 1 };
+
+	std::array<uint8_t, HAL::FLASH_STORE_BYTES> flashImage;
+	std::array<uint64_t, HAL::FLASH_STORE_BYTES / HAL::FLASH_SECTOR_BYTES> sectorErases {};
+	Sim::FlashStats flashCounts {};
+	bool flashLoaded { false };
+
+	uint32_t uartBaud { 115'200 };
+	int uartFd { -1 };
+	bool uartOpened { false };
+	Sim::UartStats uartCounts {};
+
+	struct UartTransfer {
+		const uint8_t* data;
+		size_t bytes;
+		HAL::TransferDone done;
+		void* context;
+		bool busy;
+	} uartTransfer {};
+
+	int consoleFd { -1 };
+	bool consoleOpened { false };
+	std::deque<char> consoleInput;		// Typed by the script or read from the pty.
+	void (*consoleCallback)() { nullptr };
+	bool fillConsole();
+	void consoleInterrupt();
+	uint64_t consoleLost { 0 };
+	std::string consoleLine;			// What the firmware has written of the line it's on.
+	std::string consoleReply;			// Its last whole line, for the script to check.
+
+	SSD1306 panel;
+	uint8_t* oled { panel.data() };
+	Sim::Stats simStats {};
+
+	// I2C START and STOP conditions, roughly a bit time each.
+	constexpr uint64_t START_STOP_US { 5 };
+
+	struct DisplayTransfer {
+		std::vector<uint16_t> words;	// What the DMA would read.
+		HAL::TransferDone done;
+		void* context;
+		bool busy;
+	} displayTransfer {};
+
+
+	int64_t displayTransferComplete(HAL::AlarmID id, void* userData) {
+
+		// Each STOP ends one transaction to the controller.
+		std::vector<uint8_t> transaction;
+		for (auto word : displayTransfer.words) {
+			transaction.push_back(word & 0xFF);
+			if (word & HAL::I2C_STOP) {
+				panel.write(transaction.data(), transaction.size());
+				transaction.clear();
+			}
+		}
+		if (!transaction.empty()) panel.write(transaction.data(), transaction.size());
+
+		displayTransfer.busy = false;
+		if (displayTransfer.done) displayTransfer.done(displayTransfer.context);
+		return 0;
+	}
+
+
+	Alarm* earliestDue(uint64_t before) {
+
+		Alarm* earliest = nullptr;
+		for (auto& alarm : alarms) {
+			if (alarm.used && alarm.due <= before && (!earliest || alarm.due < earliest->due))
+				earliest = &alarm;
+		}
+		return earliest;
+	}
+
+
+	// GPIO interrupts that came in while another one was running.
+	void runPendingIrqs() {
+
+		for (uint pin = 0; pin < Sim::NUM_PINS && irqDepth == 0; ++pin) {
+			auto events = pinIrqPending[pin] & pinIrqEvents[pin];
+			pinIrqPending[pin] = 0;
+			if (!events || !gpioCallback) continue;
+			++core0Interrupts;
+			++irqDepth;
+			gpioCallback(pin, events);
+			--irqDepth;
+		}
+	}
+
+
+	void fire(Alarm& alarm) {
+
+		if (alarm.due > clockUs) clockUs = alarm.due;
+		auto id = alarm.id;
+		auto core = currentCore;
+		currentCore = alarm.core;
+		if (alarm.core == 0) ++core0Interrupts;
+		++irqDepth;
+		auto reschedule = alarm.callback(id, alarm.userData);
+		--irqDepth;
+		currentCore = core;
+		runPendingIrqs();
+
+		// The callback may have cancelled it or the slot may have been reused.
+		if (!alarm.used || alarm.id != id) return;
+
+		if (reschedule > 0) alarm.due += reschedule;
+		else if (reschedule < 0) alarm.due = clockUs - reschedule;
+		else alarm.used = false;
+	}
+
+
+// Script
+
+	struct Action {
+		enum class Kind { Pin, Wait, PrintText, PrintPixels, PrintPlant, MarkResponse, PrintResponse, CheckResponse, CheckReply, PrintAdc, Console, Exit } kind;
+		uint64_t at;
+		uint pin;
+		bool level;
+	};
+
+	std::deque<Action> pending;
+	std::deque<std::string> consoleLines;	// For the Console actions, in order.
+
+	struct ResponseLimits {
+		double settledS;
+		double overshootC;
+	};
+	std::deque<ResponseLimits> responseLimits;	// For the CheckResponse actions, in order.
+	std::deque<std::string> replyPatterns;		// For the CheckReply actions, in order.
+	uint failedChecks { 0 };
+	uint64_t scriptTime { 0 };
+
+	void schedule(uint64_t afterUs, Action::Kind kind, uint pin = 0, bool level = false) {
+		if (scriptTime < clockUs) scriptTime = clockUs;
+		scriptTime += afterUs;
+		pending.push_back(Action { kind, scriptTime, pin, level });
+	}
+
+	// Full step quadrature, one edge per millisecond.
+	void detent(uint first, uint second) {
+		schedule(1000, Action::Kind::Pin, first, false);
+		schedule(1000, Action::Kind::Pin, second, false);
+		schedule(1000, Action::Kind::Pin, first, true);
+		schedule(1000, Action::Kind::Pin, second, true);
+	}
+
+	void press(uint32_t holdMs) {
+		schedule(1000, Action::Kind::Pin, PIN::ENCODER_BUTTON_PIN, false);
+		schedule(holdMs * 1000, Action::Kind::Pin, PIN::ENCODER_BUTTON_PIN, true);
+		schedule(100'000, Action::Kind::Wait);
+	}
+
+
+	// Returns false at end of input.
+	bool readCommand() {
+
+		int c;
+		while ((c = std::getchar()) != EOF) {
+			switch (c) {
+				case '+': case 'c': detent(PIN::ENCODER_PIN1, PIN::ENCODER_PIN2); return true;
+				case '-': case 'a': detent(PIN::ENCODER_PIN2, PIN::ENCODER_PIN1); return true;
+				case 'p': press(80); return true;
+				case 'l': press(2000); return true;
+				case 'w': schedule(100'000, Action::Kind::Wait); return true;
+				case 'W': schedule(1'000'000, Action::Kind::Wait); return true;
+				case 't': schedule(0, Action::Kind::PrintPlant); return true;
+				case 'm': schedule(0, Action::Kind::MarkResponse); return true;
+				case 'r': schedule(0, Action::Kind::PrintResponse); return true;
+				case 'R': {
+					std::string line;
+					while ((c = std::getchar()) != EOF && c != '\n') line += static_cast<char>(c);
+					ResponseLimits limits {};
+					if (std::sscanf(line.c_str(), "%lf %lf", &limits.settledS, &limits.overshootC) != 2) {
+						std::fprintf(stderr, "R needs the settling time and overshoot it may take, say R30 0.5\n");
+						std::exit(EXIT_FAILURE);
+					}
+					responseLimits.push_back(limits);
+					schedule(0, Action::Kind::CheckResponse);
+					return true;
+				}
+				case '<': {
+					std::string line;
+					while ((c = std::getchar()) != EOF && c != '\n') line += static_cast<char>(c);
+					replyPatterns.push_back(line);
+					schedule(0, Action::Kind::CheckReply);
+					return true;
+				}
+				case 'i': schedule(0, Action::Kind::PrintAdc); return true;
+				case 's': schedule(0, Action::Kind::PrintText); return true;
+				case 'S': schedule(0, Action::Kind::PrintPixels); return true;
+				case '#': while ((c = std::getchar()) != EOF && c != '\n'); break;
+				case '>': {
+					std::string line;
+					while ((c = std::getchar()) != EOF && c != '\n') line += static_cast<char>(c);
+					consoleLines.push_back(line + "\n");
+					schedule(0, Action::Kind::Console);
+					return true;
+				}
+				default: break;
+			}
+		}
+		return false;
+	}
+
+
+	void printPlant() {
+		auto& p = Sim::plant();
+		std::printf("plant: %.3f s, %.2f C, thermistor %.2f C, sink %.2f C, %+.2f A, drive %+.1f %%\n",
+					clockUs * 1e-6, p.plateC, p.thermistorC, p.sinkC, p.amps, Sim::bridgeDrive() * 100);
+	}
+
+
+	void printResponse() {
+
+		auto r = Sim::response();
+		std::printf("response: %.2f C to %.2f C, rise %.2f s, overshoot %.2f C, settled to %.2f C after %.2f s\n",
+					r.fromC, r.toC, r.riseS, r.overshootC, Sim::SETTLED_BAND_C, r.settledS);
+	}
+
+
+	void checkResponse() {
+
+		auto r = Sim::response();
+		auto limits = responseLimits.front();
+		responseLimits.pop_front();
+		bool ok = r.settledS <= limits.settledS && r.overshootC <= limits.overshootC;
+		if (!ok) ++failedChecks;
+		std::printf("response: %.2f C to %.2f C, settled after %.2f s of %.2f, overshoot %.2f C of %.2f, %s\n",
+					r.fromC, r.toC, r.settledS, limits.settledS, r.overshootC, limits.overshootC, ok ? "passed" : "FAILED");
+	}
+
+
+	std::vector<std::string> fields(const std::string& line) {
+
+		std::vector<std::string> out(1);
+		for (char c : line) {
+			if (c == ',') out.emplace_back();
+			else out.back() += c;
+		}
+		return out;
+	}
+
+
+	// A field of the pattern is "*" for anything, "lo:hi" for a number in that range, or text the
+	// reply's has to be.
+	bool fieldMatches(const std::string& pattern, const std::string& field) {
+
+		if (pattern == "*") return true;
+		double lo, hi;
+		if (std::sscanf(pattern.c_str(), "%lf:%lf", &lo, &hi) == 2) {
+			char* end;
+			double value = std::strtod(field.c_str(), &end);
+			return !field.empty() && *end == '\0' && value >= lo && value <= hi;
+		}
+		return pattern == field;
+	}
+
+
+	void checkReply() {
+
+		auto pattern = replyPatterns.front();
+		replyPatterns.pop_front();
+		auto want = fields(pattern);
+		auto got = fields(consoleReply);
+		bool ok = want.size() == got.size();
+		for (size_t i = 0; ok && i < want.size(); ++i) ok = fieldMatches(want[i], got[i]);
+		if (!ok) ++failedChecks;
+		std::printf("reply: %s against %s, %s\n", consoleReply.c_str(), pattern.c_str(), ok ? "passed" : "FAILED");
+	}
+
+
+	void printAdc() {
+
+		Sim::adcCaptureIndex();		// Up to now.
+		auto& a = adcTiming;
+		if (!a.conversions) {
+			std::printf("adc: no conversions\n");
+			return;
+		}
+		std::printf("adc: %llu conversions, bridge counter %u - %u, at least %u from a level\n",
+					static_cast<unsigned long long>(a.conversions), a.counterMin, a.counterMax, a.edgeMarginMin);
+	}
+
+
+	void printStats() {
+		std::printf("sim: %.3f s, i2c %llu bytes, %.1f ms busy, %.0f bytes/s while busy\n", clockUs * 1e-6,
+					static_cast<unsigned long long>(simStats.i2cBytes), simStats.i2cBusyUs * 1e-3,
+					simStats.i2cBusyUs ? simStats.i2cBytes * 1e6 / simStats.i2cBusyUs : 0.0);
+		if (consoleLost) std::printf("console: %llu bytes not delivered\n", static_cast<unsigned long long>(consoleLost));
+		if (uartCounts.bytes) {
+			std::printf("uart: %llu bytes, %llu not delivered\n", static_cast<unsigned long long>(uartCounts.bytes),
+						static_cast<unsigned long long>(uartCounts.lost));
+		}
+		if (flashCounts.programs || flashCounts.erases) {
+			std::printf("flash: %llu pages programmed, %llu sectors erased, at most %llu times each\n",
+						static_cast<unsigned long long>(flashCounts.programs), static_cast<unsigned long long>(flashCounts.erases),
+						static_cast<unsigned long long>(flashCounts.maxSectorErases));
+		}
+	}
+}
+
+
+
+// Clock and alarm pool
+
+uint64_t Sim::now() { return clockUs; }
+
+
+void Sim::setCore(uint core) { currentCore = core; }
+
+
+void Sim::sleepUntil(uint64_t us) {
+
+	sleeping = true;
+	sleepInterrupts = core0Interrupts;
+	while (clockUs < us && core0Interrupts == sleepInterrupts) {
+		if (fillConsole()) consoleInterrupt();
+		else runScript(us - clockUs);
+	}
+	sleeping = false;
+}
+
+
+void Sim::advanceUs(uint64_t us) {
+
+	auto target = clockUs + us;
+
+	// Scripted pin changes and alarms in time order.  Inside an interrupt only the pins move, their
+	// interrupts wait for it to return.
+	for (;;) {
+		bool pinDue = !pending.empty() && pending.front().kind == Action::Kind::Pin && pending.front().at <= target;
+		auto alarm = irqDepth == 0 ? earliestDue(target) : nullptr;
+		if (pinDue && (!alarm || pending.front().at <= alarm->due)) {
+			auto action = pending.front();
+			pending.pop_front();
+			if (action.at > clockUs) clockUs = action.at;
+			setPin(action.pin, action.level);
+		} else if (alarm) {
+			fire(*alarm);
+		} else {
+			break;
+		}
+		if (sleeping && core0Interrupts != sleepInterrupts) return;		// Woken at the interrupt's time.
+	}
+	if (target > clockUs) clockUs = target;
+}
+
+
+HAL::AlarmID Sim::addAlarmUs(uint64_t delayUs, HAL::AlarmCallback callback, void* userData) {
+
+	for (uint i = 0; i < NUM_ALARMS; ++i) {
+		auto& alarm = alarms[i];
+		if (!alarm.used) {
+			alarm = Alarm { true, nextAlarmID++, clockUs + delayUs, callback, userData, currentCore };
+			return alarm.id;
+		}
+	}
+	return -1;	// Pool exhausted, as the SDK reports it.
+}
+
+
+bool Sim::cancelAlarm(HAL::AlarmID id) {
+
+	for (uint i = 0; i < NUM_ALARMS; ++i) {
+		auto& alarm = alarms[i];
+		if (alarm.used && alarm.id == id) {
+			alarm.used = false;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+// Pins
+
+bool Sim::getPin(uint pin) { return pin < NUM_PINS ? !pins[pin] : false; }
+
+
+void Sim::setPin(uint pin, bool level) {
+
+	if (pin >= NUM_PINS || getPin(pin) == level) return;
+	pins[pin] = !level;	// Stored inverted so that zero initialised pins read high.
+	pinEdgeUs[pin] = clockUs;
+
+	uint32_t event = level ? HAL::EDGE_RISE : HAL::EDGE_FALL;
+	if (!(pinIrqEvents[pin] & event)) return;
+	pinIrqPending[pin] |= event;
+	runPendingIrqs();
+}
+
+
+uint64_t Sim::edgeUs(uint pin) { return pin < NUM_PINS ? pinEdgeUs[pin] : 0; }
+
+
+void Sim::setIrqEnabled(uint pin, uint32_t events, bool enabled) {
+
+	if (pin >= NUM_PINS) return;
+	if (enabled) pinIrqEvents[pin] |= events;
+	else pinIrqEvents[pin] &= ~events;
+}
+
+
+void Sim::setIrqCallback(HAL::GPIOCallback callback) { gpioCallback = callback; }
+
+
+// PWM
+
+namespace {
+
+	// First wrap interrupt due on any slice, in whole microseconds.  0 if none are enabled.
+	uint64_t nextWrapIrqUs() {
+
+		uint64_t next = 0;
+		for (uint i = 0; i < Sim::NUM_PWM_SLICES; ++i) {
+			if (!pwmSlices[i].wrapCallback || !pwmSlices[i].enabled) continue;
+			uint64_t us = (Sim::pwmNextWrapCycle(i) + PWM_CYCLES_PER_US - 1) / PWM_CYCLES_PER_US;
+			if (!next || us < next) next = us;
+		}
+		return next;
+	}
+
+
+	int64_t pwmWrapInterrupt(HAL::AlarmID id, void* userData) {
+
+		for (uint i = 0; i < Sim::NUM_PWM_SLICES; ++i) {
+			auto& slice = Sim::pwmSlice(i);
+			if (slice.wrapCallback && slice.enabled) slice.wrapCallback(i);
+		}
+		auto next = nextWrapIrqUs();
+		return next ? next - alarms[PWMWrap].due : 0;
+	}
+
+
+	void scheduleWrapIrq() {
+
+		auto next = nextWrapIrqUs();
+		if (next) alarms[PWMWrap] = Alarm { true, 0, next, pwmWrapInterrupt, nullptr, currentCore };
+		else alarms[PWMWrap].used = false;
+	}
+}
+
+
+Sim::PWMSlice& Sim::pwmSlice(uint slice) {
+
+	auto& s = pwmSlices[slice % NUM_PWM_SLICES];
+	if (s.pending && pwmCycle() >= s.latchCycle) {
+		s.levelA = s.pendingA;
+		s.levelB = s.pendingB;
+		s.pending = false;
+	}
+	return s;
+}
+
+
+void Sim::pwmSetLevels(uint slice, uint16_t levelA, uint16_t levelB) {
+
+	auto& s = pwmSlice(slice);
+	if (!s.enabled) {
+		s.levelA = levelA;
+		s.levelB = levelB;
+		return;
+	}
+	s.pendingA = levelA;
+	s.pendingB = levelB;
+	s.pending = true;
+	s.latchCycle = pwmNextWrapCycle(slice);
+}
+
+
+void Sim::pwmSetEnabled(uint slice, bool enabled) {
+
+	auto& s = pwmSlice(slice);
+	if (enabled && !s.enabled) s.enabledCycle = pwmCycle();
+	s.enabled = enabled;
+	scheduleWrapIrq();
+}
+
+
+void Sim::pwmSetWrapIrq(uint slice, bool enabled, HAL::PWMWrapCallback callback) {
+
+	pwmSlice(slice).wrapCallback = enabled ? callback : nullptr;
+	// From inside the wrap interrupt it reschedules itself when it returns.
+	if (irqDepth == 0 || !alarms[PWMWrap].used) scheduleWrapIrq();
+}
+
+
+uint64_t Sim::pwmCycle() { return clockUs * PWM_CYCLES_PER_US; }
+
+
+uint64_t Sim::pwmNextWrapCycle(uint slice) {
+
+	auto& s = pwmSlices[slice % NUM_PWM_SLICES];
+	auto period = s.periodCycles();
+	auto since = pwmCycle() - s.enabledCycle;
+	return s.enabledCycle + (since / period + 1) * period;
+}
+
+
+uint Sim::pwmCounter(uint slice, bool* countingUp) { return pwmCounterAt(slice, pwmCycle(), countingUp); }
+
+
+uint Sim::pwmCounterAt(uint slice, uint64_t cycle, bool* countingUp) {
+
+	auto& s = pwmSlices[slice % NUM_PWM_SLICES];
+	if (!s.enabled || cycle < s.enabledCycle) {
+		if (countingUp) *countingUp = true;
+		return 0;
+	}
+	uint64_t position = (cycle - s.enabledCycle) % s.periodCycles();
+	bool up = !s.phaseCorrect || position <= s.wrap;
+	if (countingUp) *countingUp = up;
+	return up ? position : s.periodCycles() - position;
+}
+
+
+// ADC and plant
+
+namespace {
+
+	// Switching noise on the bridge current, in mA.  The current falls while the low side is on and
+	// rises while the high side is, so the ripple is a triangle through its mean in the middle of
+	// each pulse, at counter 0 and at wrap.  Every edge, where the counter passes a level, also
+	// rings for CURRENT_SPIKE_CYCLES.
+	double currentNoise(uint64_t cycle) {
+
+		auto& slice = Sim::pwmSlice(BRIDGE_SLICE);
+		if (!slice.enabled || cycle < slice.enabledCycle) return 0;
+		double position = static_cast<double>((cycle - slice.enabledCycle) % slice.periodCycles()) / slice.periodCycles();
+		double ripple = position < 0.25 ? -4 * position : position < 0.75 ? 4 * position - 2 : 4 - 4 * position;
+
+		int counter = Sim::pwmCounterAt(BRIDGE_SLICE, cycle);
+		int edge = std::min(std::abs(counter - slice.levelA), std::abs(counter - slice.levelB));
+		double spike = edge < static_cast<int>(Sim::CURRENT_SPIKE_CYCLES) ? 1 - static_cast<double>(edge) / Sim::CURRENT_SPIKE_CYCLES : 0;
+		return Sim::CURRENT_RIPPLE_MA * ripple + Sim::CURRENT_SPIKE_MA * spike;
+	}
+
+
+	// The plant is passed in, it hardly moves over the samples of one capture.
+	uint16_t adcSample(uint channel, uint64_t cycle, const Sim::Plant& plant) {
+
+		double timeUs = static_cast<double>(cycle) / PWM_CYCLES_PER_US;
+		noiseSeed = noiseSeed * 1664525 + 1013904223;
+		double noise = static_cast<int>(noiseSeed >> 29) - 3.5;		// A few counts either way.
+		double counts = 0;
+
+		switch (channel) {
+			case SENSOR::TEMPERATURE_CHANNEL: {
+				double ohms = Thermistor::ohms(SENSOR::THERMISTOR.model, plant.thermistorC + Thermistor::KELVIN);
+				counts = (HAL::ADC_MAX + 1) * ohms / (ohms + SENSOR::THERMISTOR.seriesOhms);
+				break;
+			}
+			case SENSOR::CURRENT_CHANNEL:
+				counts = (HAL::ADC_MAX + 1) / 2.0
+						 + (plant.amps * 1000 + currentNoise(cycle)) * HAL::ADC_MAX / SENSOR::CURRENT_SPAN_MA;
+				break;
+			case SENSOR::SUPPLY_CHANNEL: {
+				double mv = Sim::SUPPLY_MV - std::abs(plant.amps) * Sim::SUPPLY_SAG_MV_PER_A
+							+ Sim::SUPPLY_RIPPLE_MV * std::sin(2 * M_PI * 100 * timeUs * 1e-6);
+				counts = mv * HAL::ADC_MAX / SENSOR::SUPPLY_SPAN_MV;
+				break;
+			}
+			default:
+				return 0;
+		}
+		return static_cast<uint16_t>(std::clamp(std::lround(counts + noise), 0l, static_cast<long>(HAL::ADC_MAX)));
+	}
+}
+
+
+uint16_t Sim::adcRead(uint channel) { return adcSample(channel, pwmCycle(), plant()); }
+
+
+namespace {
+
+	void startCapture(uint32_t channelMask, uint16_t* ring, size_t samples, uint32_t rateHz, uint64_t firstCycle, uint64_t strideCycles) {
+
+		auto& c = adcCapture;
+		c = AdcCapture { ring, samples, rateHz, firstCycle, strideCycles, 0, {}, 0 };
+		for (uint channel = 0; channel < HAL::ADC_CHANNELS; ++channel) {
+			if (channelMask & (1u << channel)) c.order[c.channels++] = channel;
+		}
+		if (!c.channels || !samples || (!rateHz && !strideCycles)) c.ring = nullptr;
+		adcTiming = Sim::AdcStats { 0, ~0u, 0, ~0u };
+	}
+
+
+	uint64_t conversionCycle(uint64_t k) {
+		auto& c = adcCapture;
+		return c.rateHz ? c.firstCycle + k * Sim::PWM_CLOCK_HZ / c.rateHz : c.firstCycle + k * c.strideCycles;
+	}
+
+
+	// Where the bridge's counter is at a conversion, and how far that is from the nearest level.
+	void recordConversion(uint64_t cycle) {
+
+		auto& slice = Sim::pwmSlice(BRIDGE_SLICE);
+		if (!slice.enabled) return;
+		auto counter = Sim::pwmCounterAt(BRIDGE_SLICE, cycle);
+		uint margin = std::min(std::abs(static_cast<int>(counter) - slice.levelA), std::abs(static_cast<int>(counter) - slice.levelB));
+		++adcTiming.conversions;
+		adcTiming.counterMin = std::min(adcTiming.counterMin, counter);
+		adcTiming.counterMax = std::max(adcTiming.counterMax, counter);
+		adcTiming.edgeMarginMin = std::min(adcTiming.edgeMarginMin, margin);
+	}
+}
+
+
+void Sim::adcStartCapture(uint32_t channelMask, uint32_t sampleRateHz, uint16_t* ring, size_t samples) {
+	startCapture(channelMask, ring, samples, sampleRateHz, pwmCycle() + ADC_START_CYCLES, 0);
+}
+
+
+void Sim::adcStartCaptureOnPwmWrap(uint32_t channelMask, uint slice, uint wraps, uint16_t* ring, size_t samples) {
+
+	auto period = pwmSlice(slice).periodCycles();
+	auto first = pwmNextWrapCycle(slice) + (wraps - 1) * period;
+	startCapture(channelMask, ring, samples, 0, first + ADC_START_CYCLES, wraps * period);
+}
+
+
+void Sim::adcStopCapture() { adcCapture.ring = nullptr; }
+
+
+size_t Sim::adcCaptureIndex() {
+
+	auto& c = adcCapture;
+	if (!c.ring) return 0;
+
+	// Anything older than a ring's worth is overwritten.
+	auto now = pwmCycle();
+	uint64_t due = now < c.firstCycle ? 0
+				 : c.rateHz ? (now - c.firstCycle) * c.rateHz / PWM_CLOCK_HZ + 1
+				 : (now - c.firstCycle) / c.strideCycles + 1;
+	if (due - c.taken > c.samples) c.taken = due - c.samples;
+	auto& state = plant();
+	for (; c.taken < due; ++c.taken) {
+		auto cycle = conversionCycle(c.taken);
+		recordConversion(cycle);
+		c.ring[c.taken % c.samples] = adcSample(c.order[c.taken % c.channels], cycle, state);
+	}
+	return c.taken % c.samples;
+}
+
+
+const Sim::AdcStats& Sim::adcStats() { return adcTiming; }
+
+
+double Sim::bridgeDrive() {
+
+	auto& slice = pwmSlice(BRIDGE_SLICE);
+	if (!slice.enabled || !slice.wrap) return 0;
+	// The high side is on above levelA and the low side below levelB, the dead time sits between.
+	double highSide = (slice.wrap - (slice.levelA + slice.levelB) / 2.0) / slice.wrap;
+	return std::clamp(2 * highSide - 1, -1.0, 1.0);
+}
+
+
+namespace {
+
+	// One PLANT_STEP_US at the given drive, forward Euler.  The fastest time constant, the
+	// thermistor's, is seconds so the step is nowhere near the limit.
+	void stepPlant(double drive) {
+
+		using namespace Sim;
+		auto& p = plantState;
+		double plateK = p.plateC + Thermistor::KELVIN;
+		double sinkK = p.sinkC + Thermistor::KELVIN;
+		double seebeckV = TEC_SEEBECK_V_PER_K * (p.plateC - p.sinkC);
+		p.amps = (drive * SUPPLY_MV / 1000 - seebeckV) / TEC_OHMS;
+
+		double halfJoule = p.amps * p.amps * TEC_OHMS / 2;
+		double conducted = TEC_CONDUCTANCE_W_PER_K * (p.sinkC - p.plateC);
+		double intoPlate = TEC_SEEBECK_V_PER_K * p.amps * plateK + halfJoule + conducted - PLATE_LOSS_W_PER_K * (p.plateC - PLANT_AMBIENT_C);
+		double intoSink = -TEC_SEEBECK_V_PER_K * p.amps * sinkK + halfJoule - conducted - SINK_LOSS_W_PER_K * (p.sinkC - PLANT_AMBIENT_C);
+
+		double dt = PLANT_STEP_US * 1e-6;
+		p.plateC += intoPlate * dt / PLATE_J_PER_K;
+		p.sinkC += intoSink * dt / SINK_J_PER_K;
+		p.thermistorC += (p.plateC - p.thermistorC) * dt / THERMISTOR_TAU_S;
+		plantUs += PLANT_STEP_US;
+
+		if (responseMarked && plantUs >= responseUs + responseC.size() * RESPONSE_STEP_US) responseC.push_back(p.plateC);
+	}
+}
+
+
+const Sim::Plant& Sim::plant() {
+
+	// The drive only changes at a tick, so holding it over a step is near enough.
+	if (clockUs >= plantUs + PLANT_STEP_US) {
+		double drive = bridgeDrive();
+		while (clockUs >= plantUs + PLANT_STEP_US) stepPlant(drive);
+	}
+	return plantState;
+}
+
+
+double Sim::plantTemperature() { return plant().plateC; }
+
+
+void Sim::markResponse() {
+
+	plant();
+	responseC.assign(1, plantState.plateC);
+	responseUs = plantUs;
+	responseMarked = true;
+}
+
+
+Sim::Response Sim::response() {
+
+	plant();
+	Response r {};
+	if (responseC.empty()) return r;
+	r.fromC = responseC.front();
+	r.toC = responseC.back();
+	double span = r.toC - r.fromC;
+	double direction = span < 0 ? -1 : 1;
+	double step = RESPONSE_STEP_US * 1e-6;
+
+	double rising = -1;
+	for (size_t i = 0; i < responseC.size(); ++i) {
+		double done = span ? (responseC[i] - r.fromC) / span : 1;
+		if (rising < 0 && done >= 0.1) rising = i * step;
+		if (!r.riseS && rising >= 0 && done >= 0.9) r.riseS = i * step - rising;
+		r.overshootC = std::max(r.overshootC, direction * (responseC[i] - r.toC));
+		if (std::abs(responseC[i] - r.toC) > SETTLED_BAND_C) r.settledS = (i + 1) * step;
+	}
+	return r;
+}
+
+
+// Flash
+
+namespace {
+
+	const char* flashFile() { return std::getenv("TEC_FLASH_FILE"); }
+
+	void loadFlash() {
+
+		if (flashLoaded) return;
+		flashLoaded = true;
+		flashImage.fill(0xFF);
+		auto name = flashFile();
+		if (!name) return;
+		if (auto file = std::fopen(name, "rb")) {
+			std::fread(flashImage.data(), 1, flashImage.size(), file);
+			std::fclose(file);
+		}
+	}
+
+	void saveFlash() {
+
+		auto name = flashFile();
+		if (!name) return;
+		if (auto file = std::fopen(name, "wb")) {
+			std::fwrite(flashImage.data(), 1, flashImage.size(), file);
+			std::fclose(file);
+		}
+	}
+}
+
+
+const uint8_t* Sim::flash() {
+	loadFlash();
+	return flashImage.data();
+}
+
+
+bool Sim::flashErase(uint32_t offset) {
+
+	loadFlash();
+	if (offset % HAL::FLASH_SECTOR_BYTES || offset >= HAL::FLASH_STORE_BYTES) return false;
+	std::fill_n(&flashImage[offset], HAL::FLASH_SECTOR_BYTES, 0xFF);
+	auto& erases = sectorErases[offset / HAL::FLASH_SECTOR_BYTES];
+	++flashCounts.erases;
+	flashCounts.maxSectorErases = std::max(flashCounts.maxSectorErases, ++erases);
+	saveFlash();
+	clockUs += FLASH_ERASE_US;		// With interrupts off, anything due then runs late.
+	return true;
+}
+
+
+bool Sim::flashProgram(uint32_t offset, const uint8_t* page) {
+
+	loadFlash();
+	if (offset % HAL::FLASH_PAGE_BYTES || offset >= HAL::FLASH_STORE_BYTES) return false;
+	for (uint32_t i = 0; i < HAL::FLASH_PAGE_BYTES; ++i) flashImage[offset + i] &= page[i];
+	++flashCounts.programs;
+	saveFlash();
+	clockUs += FLASH_PROGRAM_US;
+	return true;
+}
+
+
+const Sim::FlashStats& Sim::flashStats() { return flashCounts; }
+
+
+// UART
+
+namespace {
+
+	// A pseudo terminal that a reader can open as if it were one of the board's serial ports.  The
+	// simulation runs faster than the board, so it never waits for the other end: writes it won't
+	// take are lost.  -1 if there are none.
+	int openPty(const char* what) {
+
+		int fd = posix_openpt(O_RDWR | O_NOCTTY);
+		if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0) {
+			std::fprintf(stderr, "%s: no pty\n", what);
+			if (fd >= 0) close(fd);
+			return -1;
+		}
+		termios raw;
+		tcgetattr(fd, &raw);
+		cfmakeraw(&raw);
+		tcsetattr(fd, TCSANOW, &raw);
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		std::fprintf(stderr, "%s: %s\n", what, ptsname(fd));
+		return fd;
+	}
+
+
+	void openUart() {
+
+		if (uartOpened) return;
+		uartOpened = true;
+		auto name = std::getenv("TEC_TELEMETRY");
+		if (!name) return;
+		if (std::string(name) == "pty") {
+			uartFd = openPty("telemetry");
+			return;
+		}
+		uartFd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (uartFd < 0) std::fprintf(stderr, "telemetry: can't open %s\n", name);
+	}
+
+
+	int64_t uartTransferComplete(HAL::AlarmID id, void* userData) {
+
+		uartCounts.bytes += uartTransfer.bytes;
+		ssize_t written = uartFd < 0 ? 0 : write(uartFd, uartTransfer.data, uartTransfer.bytes);
+		if (uartFd >= 0) uartCounts.lost += uartTransfer.bytes - std::max<ssize_t>(written, 0);
+
+		uartTransfer.busy = false;
+		if (uartTransfer.done) uartTransfer.done(uartTransfer.context);
+		return 0;
+	}
+}
+
+
+void Sim::uartInit(uint32_t baud) {
+	uartBaud = baud;
+	openUart();
+}
+
+
+void Sim::uartWriteAsync(const uint8_t* data, size_t bytes, HAL::TransferDone done, void* context) {
+
+	// Ten bits a byte with the start and stop bits.
+	uint64_t us = (bytes * 10 * 1'000'000 + uartBaud - 1) / uartBaud;
+	// A new id each time, since done usually starts the next transfer from inside the alarm.
+	uartTransfer = UartTransfer { data, bytes, done, context, true };
+	alarms[UartDMA] = Alarm { true, nextAlarmID++, clockUs + us, uartTransferComplete, nullptr, currentCore };
+}
+
+
+bool Sim::uartBusy() { return uartTransfer.busy; }
+
+
+const Sim::UartStats& Sim::uartStats() { return uartCounts; }
+
+
+// Console
+
+namespace {
+
+	void openConsole() {
+
+		if (consoleOpened) return;
+		consoleOpened = true;
+		auto name = std::getenv("TEC_CONSOLE");
+		if (name && std::string(name) == "pty") consoleFd = openPty("console");
+	}
+
+
+	// Returns true if there was anything.
+	bool fillConsole() {
+
+		openConsole();
+		uint8_t buffer[256];
+		ssize_t got = consoleFd < 0 ? 0 : read(consoleFd, buffer, sizeof(buffer));
+		for (ssize_t i = 0; i < got; ++i) consoleInput.push_back(buffer[i]);
+		return got > 0;
+	}
+
+
+	void consoleInterrupt() {
+
+		if (!consoleCallback) return;
+		++core0Interrupts;
+		++irqDepth;
+		consoleCallback();
+		--irqDepth;
+	}
+}
+
+
+int Sim::consoleRead() {
+
+	fillConsole();
+	if (consoleInput.empty()) return -1;
+	char c = consoleInput.front();
+	consoleInput.pop_front();
+	return static_cast<uint8_t>(c);
+}
+
+
+void Sim::consoleSetInputCallback(void (*callback)()) { consoleCallback = callback; }
+
+
+void Sim::consoleWrite(const char* text, size_t bytes) {
+
+	for (size_t i = 0; i < bytes; ++i) {
+		if (text[i] != '\n') {
+			consoleLine += text[i];
+			continue;
+		}
+		consoleReply = consoleLine;
+		consoleLine.clear();
+	}
+	openConsole();
+	if (consoleFd < 0) {
+		std::fwrite(text, 1, bytes, stdout);
+		return;
+	}
+	ssize_t written = write(consoleFd, text, bytes);
+	consoleLost += bytes - std::max<ssize_t>(written, 0);
+}
+
+
+// OLED
+
+uint8_t* Sim::oledRam() { return oled; }
+
+
+void Sim::i2cTransfer(size_t bytes) {
+
+	// 9 clocks per byte including the ack.
+	uint64_t us = (bytes * 9 * 1'000'000 + I2C_FREQ - 1) / I2C_FREQ;
+	simStats.i2cBytes += bytes;
+	simStats.i2cBusyUs += us;
+	advanceUs(us);
+}
+
+
+void Sim::oledWriteAsync(const uint16_t* words, size_t count, HAL::TransferDone done, void* context) {
+
+	size_t transactions = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if ((words[i] & HAL::I2C_STOP) || i == count - 1) ++transactions;
+	}
+	size_t bytes = count + transactions;	// Plus an address byte each.
+	uint64_t us = (bytes * 9 * 1'000'000 + I2C_FREQ - 1) / I2C_FREQ + transactions * START_STOP_US;
+	simStats.i2cBytes += bytes;
+	simStats.i2cBusyUs += us;
+
+	displayTransfer.words.assign(words, words + count);
+	displayTransfer.done = done;
+	displayTransfer.context = context;
+	displayTransfer.busy = true;
+	alarms[DisplayDMA] = Alarm { true, 0, clockUs + us, displayTransferComplete, nullptr, currentCore };
+}
+
+
+bool Sim::oledBusy() { return displayTransfer.busy; }
+
+
+const Sim::Stats& Sim::stats() { return simStats; }
+
+
+void Sim::glyph(char c, uint8_t out[8]) {
+
+	for (uint i = 0; i < 8; ++i) out[i] = 0;
+	if (c <= ' ' || c > '~') return;
+
+	uint8_t v = c - ' ';
+	out[1] = 0x7E;
+	out[2] = (v & 0x3F) << 1;
+	out[3] = ((v >> 6) << 1) | 0x40;
+	out[4] = 0x42;
+	out[5] = 0x42;
+	out[6] = 0x7E;
+}
+
+
+std::string Sim::screenText() {
+
+	static std::array<std::array<uint8_t, 8>, 128> glyphs {};
+	static bool glyphsMade = false;
+	if (!glyphsMade) {
+		for (int c = '!'; c <= '~'; ++c) glyph(c, glyphs[c].data());
+		glyphsMade = true;
+	}
+
+	// Only the inside of the cell is compared so that rectangles drawn around a row still read.
+	auto matches = [](const uint8_t* cell, const std::array<uint8_t, 8>& g, uint8_t flip) {
+		for (uint i = 1; i < 7; ++i) {
+			if (((cell[i] ^ flip) & 0x7E) != (g[i] & 0x7E)) return false;
+		}
+		return true;
+	};
+
+	std::array<uint8_t, OLED_WIDTH * OLED_PAGES> glass;
+	panel.image(glass.data());
+
+	std::string text = "+" + std::string(OLED_WIDTH / 8, '-') + "+\n";
+	for (uint page = 0; page < OLED_PAGES; ++page) {
+		std::string line;
+		bool inverted = false;
+		for (uint col = 0; col < OLED_WIDTH; col += 8) {
+			const uint8_t* cell = &glass[page * OLED_WIDTH + col];
+			char found = '?';
+			for (uint8_t flip : { 0x00, 0xFF }) {
+				if (matches(cell, glyphs[' '], flip)) found = ' ';
+				for (int c = '!'; c <= '~' && found == '?'; ++c) {
+					if (matches(cell, glyphs[c], flip)) found = c;
+				}
+				if (found != '?') {
+					inverted |= flip != 0;
+					break;
+				}
+			}
+			line += found;
+		}
+		text += (inverted ? ">" : "|") + line + "|\n";
+	}
+	text += "+" + std::string(OLED_WIDTH / 8, '-') + "+\n";
+	return text;
+}
+
+
+std::string Sim::screenPixels() {
+
+	std::array<uint8_t, OLED_WIDTH * OLED_PAGES> glass;
+	panel.image(glass.data());
+
+	std::string pixels;
+	for (uint y = 0; y < OLED_PAGES * 8; ++y) {
+		for (uint x = 0; x < OLED_WIDTH; ++x) {
+			pixels += (glass[(y / 8) * OLED_WIDTH + x] >> (y % 8)) & 1 ? '#' : '.';
+		}
+		pixels += '\n';
+	}
+	return pixels;
+}
+
+
+// Script
+
+void Sim::runScript(uint64_t maxUs) {
+
+	// At the end let the firmware run on for a while to finish what it's doing.
+	if (pending.empty() && !readCommand()) schedule(2'000'000, Action::Kind::Exit);
+
+	auto action = pending.front();
+	if (action.at > clockUs) {
+		advanceUs(std::min<uint64_t>(maxUs, action.at - clockUs));
+		return;
+	}
+	pending.pop_front();
+
+	switch (action.kind) {
+		case Action::Kind::Pin:
+			setPin(action.pin, action.level);
+			break;
+		case Action::Kind::Wait:
+			break;
+		case Action::Kind::PrintText:
+			std::cout << screenText() << std::flush;
+			break;
+		case Action::Kind::PrintPixels:
+			std::cout << screenPixels() << std::flush;
+			break;
+		case Action::Kind::PrintPlant:
+			printPlant();
+			break;
+		case Action::Kind::MarkResponse:
+			markResponse();
+			break;
+		case Action::Kind::PrintResponse:
+			printResponse();
+			break;
+		case Action::Kind::CheckResponse:
+			checkResponse();
+			break;
+		case Action::Kind::CheckReply:
+			checkReply();
+			break;
+		case Action::Kind::PrintAdc:
+			printAdc();
+			break;
+		case Action::Kind::Console:
+			for (char c : consoleLines.front()) consoleInput.push_back(c);
+			consoleLines.pop_front();
+			consoleInterrupt();
+			break;
+		case Action::Kind::Exit:
+			std::cout << screenText();
+			printPlant();
+			printStats();
+			if (failedChecks) std::printf("checks: %u failed\n", failedChecks);
+			std::exit(failedChecks ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+}
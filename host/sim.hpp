@@ -0,0 +1,224 @@
+#ifndef _SIM_HPP__
+#define _SIM_HPP__
+
+// Simulated board behind host/hal_host.cpp.
+// Time is virtual: it only moves when the firmware sleeps, busy waits or idles, so runs are
+// deterministic and faster than real time.  Inputs are scripted on stdin, see runScript().
+
+#include "hal.hpp"
+#include <string>
+
+
+namespace Sim {
+
+	inline constexpr uint NUM_PINS		{ HAL::NUM_GPIOS };
+	inline constexpr uint NUM_ALARMS	{ 16 };	// Same as the SDK's default alarm pool.
+	inline constexpr uint NUM_PWM_SLICES	{ 8 };
+	inline constexpr uint OLED_WIDTH	{ 128 };
+	inline constexpr uint OLED_PAGES	{ 8 };
+	inline constexpr uint32_t I2C_FREQ	{ 400'000 };
+
+
+// Clock and alarm pool.
+	uint64_t now();
+	void advanceUs(uint64_t us);	// Fires any alarms that fall due, unless called from one.
+	// Core 0 sleeping: runs the script and time on until the time, or until an interrupt of core
+	// 0's.  Alarms and the PWM wrap belong to the core that set them up, the rest are core 0's.
+	void sleepUntil(uint64_t us);
+	void setCore(uint core);		// Which core is running, while launchCore1 runs core 1's entry.
+	HAL::AlarmID addAlarmUs(uint64_t delayUs, HAL::AlarmCallback callback, void* userData);
+	bool cancelAlarm(HAL::AlarmID id);
+
+// Pins.  Inputs idle high as if pulled up.
+	bool getPin(uint pin);
+	// Raises the GPIO IRQ if enabled for the edge.  If another interrupt is running it waits, like
+	// the NVIC would, and runs as soon as that one returns.
+	void setPin(uint pin, bool level);
+	uint64_t edgeUs(uint pin);			// When the pin last changed.
+	void setIrqEnabled(uint pin, uint32_t events, bool enabled);
+	void setIrqCallback(HAL::GPIOCallback callback);
+
+// PWM.  The counters run at PWM_CLOCK_HZ from when their slice is enabled.  Levels written to a
+// running slice are double buffered as on the RP2040 and take effect at the next wrap, which for
+// phase correct is when the counter gets back down to 0.
+	inline constexpr uint64_t PWM_CLOCK_HZ { 125'000'000 };
+
+	struct PWMSlice {
+		uint16_t wrap;
+		uint16_t levelA;		// The levels in effect.
+		uint16_t levelB;
+		bool invertA;
+		bool invertB;
+		bool phaseCorrect;
+		bool enabled;
+
+		uint16_t pendingA;		// Written, waiting for the wrap.
+		uint16_t pendingB;
+		bool pending;
+		uint64_t latchCycle;
+		uint64_t enabledCycle;
+		HAL::PWMWrapCallback wrapCallback;	// Set while the wrap interrupt is enabled.
+
+		uint64_t periodCycles() const { return phaseCorrect ? 2 * (wrap + 1ull) : wrap + 1ull; }
+	};
+	PWMSlice& pwmSlice(uint slice);		// Brought up to the current time first.
+	void pwmSetLevels(uint slice, uint16_t levelA, uint16_t levelB);
+	void pwmSetEnabled(uint slice, bool enabled);
+	void pwmSetWrapIrq(uint slice, bool enabled, HAL::PWMWrapCallback callback);
+	uint64_t pwmCycle();					// Counter clock cycles since the start.
+	uint64_t pwmNextWrapCycle(uint slice);
+	uint pwmCounter(uint slice, bool* countingUp = nullptr);
+	uint pwmCounterAt(uint slice, uint64_t cycle, bool* countingUp = nullptr);
+
+// ADC.  Synthetic inputs, each with a few counts of noise:
+//   SENSOR::TEMPERATURE_CHANNEL   the plant's thermistor, through SENSOR::THERMISTOR
+//   SENSOR::CURRENT_CHANNEL       the plant's TEC current, plus switching ripple that is zero mid
+//                                 pulse and a spike at each edge
+//   SENSOR::SUPPLY_CHANNEL        SUPPLY_MV, sagging with the current, plus 100 Hz ripple
+// A capture fills the ring, in whole samples at the PWM clock's resolution, each time the index
+// is read.  Conversions sample ADC_START_CYCLES after they are due, the DMA and the ADC's clock
+// crossing.  Every conversion is checked against the bridge's counter, see AdcStats.
+	inline constexpr double SUPPLY_MV			{ 5'000 };
+	inline constexpr double SUPPLY_SAG_MV_PER_A	{ 50 };
+	inline constexpr double SUPPLY_RIPPLE_MV	{ 40 };
+	inline constexpr double CURRENT_RIPPLE_MA	{ 200 };
+	inline constexpr double CURRENT_SPIKE_MA	{ 1'000 };
+	inline constexpr uint CURRENT_SPIKE_CYCLES	{ 25 };
+	inline constexpr uint64_t ADC_START_CYCLES	{ 12 };
+
+	struct AdcStats {
+		uint64_t conversions;
+		uint counterMin;		// The bridge slice's counter when they sampled.
+		uint counterMax;
+		uint edgeMarginMin;		// Closest they came to levelA or levelB, in counts.
+	};
+	uint16_t adcRead(uint channel);
+	void adcStartCapture(uint32_t channelMask, uint32_t sampleRateHz, uint16_t* ring, size_t samples);
+	void adcStartCaptureOnPwmWrap(uint32_t channelMask, uint slice, uint wraps, uint16_t* ring, size_t samples);
+	void adcStopCapture();
+	size_t adcCaptureIndex();
+	const AdcStats& adcStats();
+
+// Thermal plant.  Two lumps, the plate the thermistor sits on and the heat sink, with the TEC
+// between them and each losing heat to ambient.  The TEC's current is SUPPLY_MV times the bridge
+// drive, less its Seebeck voltage, over TEC_OHMS, and + heats the plate.  It carries
+// TEC_SEEBECK_V_PER_K times the current times the junction's temperature from one side to the
+// other, half its Joule heat goes into each side and TEC_CONDUCTANCE leaks back through it.
+// The thermistor follows the plate with THERMISTOR_TAU_S, the bead and its epoxy, which is most
+// of the lag the loop sees.  Stepped every PLANT_STEP_US from when it was last brought up to date.  The drive is worked out
+// from the levels on the PWM_A/PWM_B slice, +1 is full heating.
+	inline constexpr double PLANT_AMBIENT_C			{ 25.0 };
+	inline constexpr double TEC_OHMS				{ 1.2 };
+	inline constexpr double TEC_SEEBECK_V_PER_K		{ 0.05 };
+	inline constexpr double TEC_CONDUCTANCE_W_PER_K	{ 0.5 };
+	inline constexpr double PLATE_J_PER_K			{ 20.0 };		// 20 g of aluminium.
+	inline constexpr double PLATE_LOSS_W_PER_K		{ 0.05 };
+	inline constexpr double SINK_J_PER_K			{ 200.0 };
+	inline constexpr double SINK_LOSS_W_PER_K		{ 2.0 };		// A small finned sink, no fan.
+	inline constexpr double THERMISTOR_TAU_S		{ 2.0 };
+	inline constexpr uint64_t PLANT_STEP_US			{ 1'000 };
+
+	struct Plant {
+		double plateC;
+		double sinkC;
+		double thermistorC;
+		double amps;
+	};
+	const Plant& plant();		// Brought up to the current time first.
+	double plantTemperature();	// The plate's.
+	double bridgeDrive();
+
+	// Step response of the plate from the last markResponse(), against where it ended up.
+	inline constexpr double SETTLED_BAND_C			{ 0.1 };
+	struct Response {
+		double fromC;
+		double toC;
+		double riseS;			// 10 % to 90 % of the way.
+		double overshootC;		// Past toC, away from fromC.
+		double settledS;		// From the mark to staying within SETTLED_BAND_C of toC.
+	};
+	void markResponse();
+	Response response();
+
+// Flash.  HAL's settings region, erased to 0xFF.  Programming can only clear bits, as on the NOR
+// flash, and each operation stalls the firmware, interrupts and all, for as long as it would on
+// the board.  Kept in the file named by
+// the TEC_FLASH_FILE environment variable, if set, so settings survive from one run to the next.
+// Otherwise it starts erased every run, which keeps runs repeatable.
+	inline constexpr uint64_t FLASH_PROGRAM_US	{ 500 };
+	inline constexpr uint64_t FLASH_ERASE_US	{ 50'000 };
+
+	struct FlashStats {
+		uint64_t programs;
+		uint64_t erases;
+		uint64_t maxSectorErases;	// Of the most worn sector.
+	};
+	const uint8_t* flash();
+	bool flashErase(uint32_t offset);
+	bool flashProgram(uint32_t offset, const uint8_t* page);
+	const FlashStats& flashStats();
+
+// Console, the firmware's stdio UART.  Input is what the script types with '>', and what comes in
+// on a pseudo terminal if TEC_CONSOLE is "pty", its name printed on stderr.  Output goes to the
+// pty if there is one, otherwise to stdout along with everything else.
+	int consoleRead();
+	void consoleWrite(const char* text, size_t bytes);
+	void consoleSetInputCallback(void (*callback)());
+
+// UART.  Bytes take their time on the wire at the baud rate, then go to TEC_TELEMETRY: a file
+// name, or "pty" for a pseudo terminal whose name is printed on stderr, standing in for a USB
+// serial adapter.  Unset, they go nowhere.
+	struct UartStats {
+		uint64_t bytes;
+		uint64_t lost;		// The file or pty wouldn't take them.
+	};
+	void uartInit(uint32_t baud);
+	// done is called, as an interrupt, once they have all gone.  Doesn't use a slot of the alarm
+	// pool.
+	void uartWriteAsync(const uint8_t* data, size_t bytes, HAL::TransferDone done, void* context);
+	bool uartBusy();
+	const UartStats& uartStats();
+
+// OLED.  The panel RAM, which the glass shows from the display start line on.
+	struct Stats {
+		uint64_t i2cBytes;
+		uint64_t i2cBusyUs;
+	};
+	uint8_t* oledRam();
+	void i2cTransfer(size_t bytes);	// Blocks the caller for the time the bytes take on the bus.
+
+	// Display DMA.  The words reach the SSD1306 emulator and done is called, as an interrupt, once
+	// the bus time for them has passed.  Doesn't use a slot of the alarm pool.
+	void oledWriteAsync(const uint16_t* words, size_t count, HAL::TransferDone done, void* context);
+	bool oledBusy();
+	const Stats& stats();
+
+	// Placeholder 8x8 glyphs.  Not a real font, but every printable character gets a unique
+	// pattern so the screen can be read back as text.
+	void glyph(char c, uint8_t out[8]);
+	std::string screenText();	// 16x8 cells of the 8x8 font.  Inverted rows are marked with '>'.
+	std::string screenPixels();
+
+// Input script, one command per character.  Pin changes happen at their time even if the firmware
+// is busy, as they would on the board.
+//   + or c   clockwise detent         - or a   anticlockwise detent
+//   p        click the button         l        long press the button
+//   w        wait 100 ms              W        wait 1 s
+//   s / S    print the screen as text / pixels
+//   t        print the plant temperatures, current and drive
+//   m        mark the start of a step response, say just before changing the setpoint
+//   r        print the step response since the mark
+//   R        check it against the rest of the line, the longest it may take to settle and the most
+//            it may overshoot, say "R30 0.5"
+//   <        check the console's last reply against the rest of the line, field by field between
+//            the commas: "*" for anything, "lo:hi" for a number in that range, otherwise the text,
+//            say "<DONE,*,1:3"
+//   i        print where the ADC conversions landed on the bridge's PWM counter
+//   >        type the rest of the line on the console, say ">PID:KP?"
+//   #        comment to end of line
+// At end of input the screen and stats are printed and the program exits, nonzero if any check
+// failed.  host/step.sim and host/tune.sim are scenarios for CI.
+	void runScript(uint64_t maxUs = 1'000);	// Runs the next action, or time on by up to maxUs.
+}
+
+#endif // _SIM_HPP__
@@ -0,0 +1,134 @@
+#include "ssd1306.hpp"
+
+
+namespace {
+
+	// Number of bytes including the opcode.
+	uint8_t commandSize(uint8_t opcode) {
+
+		switch (opcode) {
+			case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+				return 2;
+			case 0x21: case 0x22: case 0xA3:
+				return 3;
+			case 0x29: case 0x2A:
+				return 6;
+			case 0x26: case 0x27:
+				return 7;
+			default:
+				return 1;
+		}
+	}
+}
+
+
+SSD1306::SSD1306() :
+			ram(),
+			addressing(Addressing::Page),
+			column(0),
+			page(0),
+			columnStart(0),
+			columnEnd(WIDTH - 1),
+			pageStart(0),
+			pageEnd(PAGES - 1),
+			startLine(0),
+			command(),
+			commandLength(0) {}
+
+
+// Each control byte says whether what follows is commands or data (D/C, bit 6) and whether just one
+// byte follows before the next control byte (Co, bit 7) or the rest of the transaction.
+void SSD1306::write(const uint8_t* data, size_t len) {
+
+	size_t i = 0;
+	while (i < len) {
+		uint8_t control = data[i++];
+		bool isData = control & 0x40;
+		bool continuation = control & 0x80;
+		size_t end = continuation ? ((i < len) ? i + 1 : len) : len;
+
+		for (; i < end; ++i) {
+			if (isData) writeData(data[i]);
+			else writeCommand(data[i]);
+		}
+	}
+}
+
+
+void SSD1306::writeCommand(uint8_t byte) {
+
+	command[commandLength++] = byte;
+	if (commandLength == commandSize(command[0])) {
+		execute();
+		commandLength = 0;
+	}
+}
+
+
+void SSD1306::execute() {
+
+	uint8_t opcode = command[0];
+
+	if (opcode <= 0x0F) {
+		column = (column & 0xF0) | opcode;
+	} else if (opcode <= 0x1F) {
+		column = ((opcode & 0x0F) << 4) | (column & 0x0F);
+	} else if (opcode == 0x20) {
+		addressing = static_cast<Addressing>(command[1] & 0x03);
+	} else if (opcode == 0x21) {
+		columnStart = command[1] & 0x7F;
+		columnEnd = command[2] & 0x7F;
+		column = columnStart;
+	} else if (opcode == 0x22) {
+		pageStart = command[1] & 0x07;
+		pageEnd = command[2] & 0x07;
+		page = pageStart;
+	} else if (opcode >= 0x40 && opcode <= 0x7F) {
+		startLine = opcode & 0x3F;
+	} else if (opcode >= 0xB0 && opcode <= 0xB7) {
+		page = opcode & 0x07;
+	}
+}
+
+
+// Row y of the glass shows RAM row y + startLine, round the end of the RAM.
+void SSD1306::image(uint8_t* glass) const {
+
+	constexpr unsigned ROWS { PAGES * 8 };
+	for (unsigned y = 0; y < ROWS; ++y) {
+		unsigned from = (y + startLine) % ROWS;
+		for (unsigned x = 0; x < WIDTH; ++x) {
+			uint8_t bit = (ram[(from / 8) * WIDTH + x] >> (from % 8)) & 1;
+			auto& byte = glass[(y / 8) * WIDTH + x];
+			byte = (byte & ~(1 << (y % 8))) | (bit << (y % 8));
+		}
+	}
+}
+
+
+void SSD1306::writeData(uint8_t byte) {
+
+	ram[page * WIDTH + column] = byte;
+
+	switch (addressing) {
+		case Addressing::Page:
+			column = (column == columnEnd) ? columnStart : column + 1;
+			break;
+		case Addressing::Horizontal:
+			if (column == columnEnd) {
+				column = columnStart;
+				page = (page == pageEnd) ? pageStart : page + 1;
+			} else {
+				++column;
+			}
+			break;
+		case Addressing::Vertical:
+			if (page == pageEnd) {
+				page = pageStart;
+				column = (column == columnEnd) ? columnStart : column + 1;
+			} else {
+				++page;
+			}
+			break;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef _SSD1306_HPP__
+#define _SSD1306_HPP__
+
+// Interprets the I2C byte stream sent to an SSD1306 and keeps its display RAM.
+// Covers the addressing and display start line commands the firmware uses, other commands are
+// skipped with their arguments.
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+
+class SSD1306 {
+
+public:
+	static constexpr unsigned WIDTH { 128 };
+	static constexpr unsigned PAGES { 8 };
+
+	enum class Addressing : uint8_t { Horizontal = 0, Vertical = 1, Page = 2 };
+
+private:
+	std::array<uint8_t, WIDTH * PAGES> ram;
+	Addressing addressing;
+	uint8_t column, page;
+	uint8_t columnStart, columnEnd;
+	uint8_t pageStart, pageEnd;
+	uint8_t startLine;		// The RAM row shown at the top of the glass.
+
+	// Multi byte commands are collected here until complete.
+	std::array<uint8_t, 8> command;
+	uint8_t commandLength;
+
+	void writeCommand(uint8_t byte);
+	void writeData(uint8_t byte);
+	void execute();
+
+public:
+	SSD1306();
+
+	void write(const uint8_t* data, size_t len);	// One I2C transaction, without the address byte.
+	uint8_t* data() { return ram.data(); }
+	const uint8_t* data() const { return ram.data(); }
+	void image(uint8_t* glass) const;		// What's on the glass, laid out like the RAM.
+};
+
+#endif // _SSD1306_HPP__
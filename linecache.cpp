@@ -0,0 +1,110 @@
+#include "linecache.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+LineCache::LineCache(uint8_t* arena, uint bytes) :
+			arena(arena),
+			size(std::min(bytes, 0xFFFFu)),
+			next(0),
+			stores(0),
+			lines(),
+			stats() {}
+
+
+LineCache::Line* LineCache::find(const char* key, int font, bool inverted) {
+
+	for (auto& line : lines) {
+		if (line.key == key && line.font == font && line.inverted == inverted) return &line;
+	}
+	return nullptr;
+}
+
+
+// A free one, or else the one stored longest ago.
+LineCache::Line& LineCache::slot() {
+
+	auto oldest = &lines[0];
+	for (auto& line : lines) {
+		if (!line.key) return line;
+		if (line.stored < oldest->stored) oldest = &line;
+	}
+	oldest->key = nullptr;
+	++stats.evictions;
+	return *oldest;
+}
+
+
+// The next bytes of the ring, from the start again if they would run off the end.  Whatever was
+// there goes.
+bool LineCache::allocate(Line& line, uint bytes) {
+
+	if (bytes > size) return false;
+	if (next + bytes > size) next = 0;
+	for (auto& other : lines) {
+		if (!other.key || &other == &line) continue;
+		if (other.offset < next + bytes && next < other.offset + other.bytes) {
+			other.key = nullptr;
+			++stats.evictions;
+		}
+	}
+	line.offset = next;
+	line.bytes = bytes;
+	next += bytes;
+	return true;
+}
+
+
+bool LineCache::draw(FrameBuffer& frameBuffer, const char* str, int row, int font, bool inverted) {
+
+	auto line = find(str, font, inverted);
+	uint length = strnlen(str, MAX_TEXT + 1);
+	uint pages = HAL::fontPages(font);
+	if (!line || line->length != length || std::memcmp(line->text, str, length) != 0 || row < 0 || row + pages > FrameBuffer::PAGES) {
+		++stats.misses;
+		return false;
+	}
+
+	uint columns = line->bytes / pages;
+	for (uint page = 0; page < pages; ++page) {
+		std::memcpy(frameBuffer.data() + (row + page) * FrameBuffer::WIDTH, arena + line->offset + page * columns, columns);
+		frameBuffer.markDirty(row + page, 0, columns - 1);
+	}
+	++stats.hits;
+	return true;
+}
+
+
+void LineCache::store(FrameBuffer& frameBuffer, const char* str, int row, int font, bool inverted) {
+
+	uint length = strnlen(str, MAX_TEXT + 1);
+	uint pages = HAL::fontPages(font);
+	if (length == 0 || length > MAX_TEXT || row < 0 || row + pages > FrameBuffer::PAGES) return;
+	uint columns = std::min(length * HAL::fontWidth(font), FrameBuffer::WIDTH);
+	uint bytes = columns * pages;
+
+	// New text the same size goes where the old was.
+	auto line = find(str, font, inverted);
+	if (line && line->bytes != bytes) line->key = nullptr;
+	if (!line || !line->key) {
+		line = &slot();
+		if (!allocate(*line, bytes)) return;
+	}
+
+	for (uint page = 0; page < pages; ++page)
+		std::memcpy(arena + line->offset + page * columns, frameBuffer.data() + (row + page) * FrameBuffer::WIDTH, columns);
+	line->key = str;
+	line->font = font;
+	line->inverted = inverted;
+	line->length = length;
+	std::memcpy(line->text, str, length);
+	line->stored = stores++;
+}
+
+
+void LineCache::clear() {
+
+	for (auto& line : lines) line.key = nullptr;
+	next = 0;
+}
@@ -0,0 +1,70 @@
+#ifndef _LINECACHE_HPP__
+#define _LINECACHE_HPP__
+
+// Text lines already rendered into the back buffer, kept as the bytes they came out as, so that
+// drawing one again is a copy instead of rasterising every glyph from the font again.
+//
+// A line is looked up by where its text lives, a menu item's content, with its font and whether
+// it's inverted, so an item has its own normal and selected bitmaps.  The text is kept as well and
+// compared on a hit, so a line whose content has changed since, a setting's value, is rendered
+// again and replaces its old bitmap.  Lines are always at column 0, the way the menus draw them.
+//
+// The bitmaps share one arena of a fixed size, filled in turn round a ring: a line that doesn't
+// fit in what's left replaces the oldest ones.  Nothing is allocated.
+
+#include "hal.hpp"
+#include "framebuffer.hpp"
+
+#include <array>
+
+
+class LineCache {
+
+public:
+	static constexpr uint MAX_LINES { 24 };
+	static constexpr uint MAX_TEXT { 21 };		// Longer lines aren't kept.
+
+	struct Stats {
+		uint32_t hits;
+		uint32_t misses;
+		uint32_t evictions;		// Lines dropped for the room, not ones replaced by their own new text.
+	};
+
+private:
+	struct Line {
+		const char* key;		// nullptr for a free slot.
+		int8_t font;
+		bool inverted;
+		uint8_t length;
+		char text[MAX_TEXT];
+		uint16_t offset;		// In the arena.
+		uint16_t bytes;			// pages * columns, a page after another.
+		uint32_t stored;		// When, in stores, for replacing the oldest.
+	};
+
+	uint8_t* const arena;
+	const uint size;
+	uint next;					// Where the ring takes the next bitmap from.
+	uint32_t stores;
+	std::array<Line, MAX_LINES> lines;
+	Stats stats;
+
+	Line* find(const char* key, int font, bool inverted);
+	Line& slot();
+	bool allocate(Line& line, uint bytes);
+
+public:
+	template <size_t N>
+	LineCache(uint8_t (&arena)[N]) : LineCache(arena, N) {}
+	LineCache(uint8_t* arena, uint bytes);
+
+	// Copies the line into the frame buffer if it has it as it is now.  False if it needs rendering.
+	bool draw(FrameBuffer& frameBuffer, const char* str, int row, int font, bool inverted);
+	// Keeps the line that was just rendered at row.
+	void store(FrameBuffer& frameBuffer, const char* str, int row, int font, bool inverted);
+	void clear();
+
+	const Stats& getStats() const { return stats; }
+};
+
+#endif // _LINECACHE_HPP__
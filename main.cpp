@@ -1,78 +1,191 @@
 #include "main.hpp"
-#include "hardware/pwm.h"
-#include "hardware/i2c.h"
-#include "hardware/irq.h"
 #include "menu.hpp"
 #include "gpio.hpp"
-
+#include "framebuffer.hpp"
+#include "linecache.hpp"
+#include "display.hpp"
+#include "events.hpp"
+#include "control.hpp"
+#include "hbridge.hpp"
+#include "adc.hpp"
+#include "settingslog.hpp"
+#include "telemetry.hpp"
+#include "console.hpp"
+#include "scheduler.hpp"
+
+#include <algorithm>
 #include <iostream>
-#include <vector>
-#include <functional>
-#include <memory>
 
 
-OBDISP oled;
 uint8_t bbuffer[1024];
+FrameBuffer frameBuffer { bbuffer };
+uint8_t lineCacheArena[OLED::LINE_CACHE_BYTES];
+LineCache lineCache { lineCacheArena };
+FrameBufferDisplay display { frameBuffer, &lineCache };
 
+using MainMenu = Menu<FrameBufferDisplay>;
 
-const std::function<void(std::string&, int, bool, int)> Menu::drawLineFunction { 
-	[](std::string& str, int yPos, bool inv, int fontCmd) { 
- 		obdWriteString(&oled, false, 0, yPos, const_cast<char*>(str.c_str()), fontCmd, inv, true); 
-}};
-
-const std::function<void(int,int,int,int,uint8_t,uint8_t)> Menu::drawRectangleFunction {
-	[](int x1, int y1, int x2, int y2, uint8_t colour, uint8_t filled) {
- 		obdRectangle(&oled, x1, y1, x2, y2, colour, filled);
-}};
-
-const std::function<void()> Menu::dumpBufferFunction {
-		[]() { obdDumpBuffer(&oled, bbuffer);
-}};
 
+// What the menus edit, on core 0 only.  The control loop on core 1 gets the setpoint through
+// controlLoop, never from here.
+using Decimal = Fixed<15, 16>;
 
 struct Settings {
 	int speed = 100;
-	double height = 120.0;
+	Decimal height = 120;
+	int setpoint = 15;		// Degrees C.
+	PID::Gains gains { CONTROL::KP, CONTROL::KI, CONTROL::KD, CONTROL::D_FILTER_S };
 } s;
 
-std::unique_ptr<Menu> currentMenu;
-//Menu* currentMenu;
+// Keys in flash.  Never reuse one for something else, add a new one.
+enum SettingKey : uint16_t { SpeedKey = 1, HeightKey, SetpointKey, GainsKey };
+
+SettingsLog::Entry settingsEntries[] {
+	{ SpeedKey, &s.speed, sizeof(s.speed) },
+	{ HeightKey, &s.height, sizeof(s.height) },
+	{ SetpointKey, &s.setpoint, sizeof(s.setpoint) },
+	{ GainsKey, &s.gains, sizeof(s.gains) },
+};
+SettingsLog settingsLog { settingsEntries, STORE::SAVE_DELAY_US };
+
+// Everything core 0 does after boot runs as one of its tasks, see initTasks().
+Scheduler scheduler;
+Scheduler::TaskID saveTask { Scheduler::MAX_TASKS };
+Scheduler::TaskID consoleTask { Scheduler::MAX_TASKS };
+Scheduler::TaskID displayTask { Scheduler::MAX_TASKS };
+Scheduler::TaskID animationTask { Scheduler::MAX_TASKS };
+
+// Saved once they have stopped changing for a while.
+void settingsChanged() {
+	settingsLog.changed();
+	scheduler.after(saveTask, STORE::SAVE_DELAY_US);
+}
 
+// What the menus show, copied from the control loop on core 0.
+struct Readings {
+	Decimal temperature = 0;	// Degrees C, to 0.1.
+} r;
 
 
-void initPWM() {
-	
-	auto sliceNum = pwm_gpio_to_slice_num(PIN::PWM_A);
-	gpio_set_function(PIN::PWM_A, GPIO_FUNC_PWM);
-	gpio_set_function(PIN::PWM_B, GPIO_FUNC_PWM);
-	gpio_set_drive_strength(PIN::PWM_A, GPIO_DRIVE_STRENGTH_8MA);
-	gpio_set_drive_strength(PIN::PWM_B, GPIO_DRIVE_STRENGTH_8MA);
-	
-	pwm_set_wrap(sliceNum, CONSTANT::PWM_WRAP_VAL_PHASE);
-	pwm_set_output_polarity(sliceNum, true, true);
-	pwm_set_phase_correct(sliceNum, true);
+// Everything the menus need is static, nothing is allocated after boot.
+MenuStack<FrameBufferDisplay> menuStack;
+extern MainMenu mainMenu;
+extern MainMenu subMenu;
+
+MenuTitle mainTitle { "MENU" };
+MenuButton mainOne { "One", [](){ menuStack.push(subMenu); } };
+MenuSetting<int> mainSpeed { "Spd:", s.speed, 0, 200, true, 0, settingsChanged };
+MenuSetting<int> mainSetpoint { "Set C:", s.setpoint, -10, 60, false, 0, setpointChanged };
+MenuSetting<Decimal> mainTemperature { "Temp C:", r.temperature, -40, 125, false, 1 };
+MenuButton mainTune { "Autotune", startAutotune };
+MenuButton mainThree { "Three" };
+MenuButton mainFour { "Four" };
+BasicMenuItem* const mainItems[] { &mainTitle, &mainOne, &mainSpeed, &mainSetpoint, &mainTemperature, &mainTune, &mainThree, &mainFour };
+
+MenuTitle subTitle { "MENU 2" };
+MenuButton subHi { "Say Hi" };
+MenuButton subHo { "Say Ho" };
+MenuButton subNo { "Say No Thank You" };	// Wider than the big font, it scrolls when selected.
+BasicMenuItem* const subItems[] { &subTitle, &subHi, &subHo, &subNo };
+
+// One producer each: the encoder's GPIO interrupt and the button debounce timer's.
+InputQueue encoderQueue;
+InputQueue buttonQueue;
+
+
+MainMenu mainMenu { display, mainItems, 128, 64, 8, 8, 1, MenuUtils::Alignment::Center };
+MainMenu subMenu { display, subItems, 128, 64, 12, 16, HAL::FONT_12x16, MenuUtils::Alignment::Center, 1, [](){ menuStack.pop(); } };
+
+
+
+// All the sensor channels, decimated to one value each per control tick.  Core 1 only.
+using SensorADC = AdcCapture<SENSOR::RING_SAMPLES, SENSOR::CIC_ORDER, SENSOR::DECIMATION>;
+SensorADC adc;
+using ThermistorTable = Thermistor::Table<SENSOR::THERMISTOR, 12 + SensorADC::FRACTION_BITS>;
+
+// Milli degrees C.  Called once per tick, so it is what drains the ADC ring.
+int32_t readTemperature() {
+
+	adc.poll();
+	return ThermistorTable::milliC(adc.value(SENSOR::TEMPERATURE_CHANNEL));
+}
+
+
+// Milli amps, + heating.  Whatever the last poll left.
+int32_t readCurrent() {
+
+	auto full = static_cast<int64_t>(adc.value(SENSOR::CURRENT_CHANNEL)) * SENSOR::CURRENT_SPAN_MA;
+	return static_cast<int32_t>(full >> (12 + SensorADC::FRACTION_BITS)) - SENSOR::CURRENT_SPAN_MA / 2;
+}
+
+
+Telemetry telemetry;
+
+// Every tick, on core 1.
+void sendTelemetry(const ControlLoop::Sample& sample) {
+
+	auto clip = [](uint32_t us) { return static_cast<uint16_t>(std::min<uint32_t>(us, UINT16_MAX)); };
+	telemetry.push({ sample.tick, static_cast<uint32_t>(sample.startUs), sample.measurement, sample.setpoint,
+					 static_cast<int16_t>(sample.output), static_cast<int16_t>(readCurrent()), clip(sample.execUs), clip(sample.lateUs) });
+}
+
+
+HBridge bridge { { PIN::PWM_A, PIN::PWM_B, CONSTANT::PWM_WRAP_VAL_PHASE, CONSTANT::DEAD_TIME_CYCL, CONSTANT::MIN_PULSE_CYCL } };
+PID pid;
+ControlLoop controlLoop { pid, s.gains, readTemperature, [](int32_t duty){ bridge.set(duty); }, sendTelemetry };
 
-	pwm_set_both_levels(sliceNum, (CONSTANT::PWM_WRAP_VAL_PHASE / 2) + (CONSTANT::DEAD_TIME_CYCL / 2), (CONSTANT::PWM_WRAP_VAL_PHASE / 2) - (CONSTANT::DEAD_TIME_CYCL / 2));
-	pwm_set_enabled(sliceNum, true);
+
+void setpointChanged() {
+	controlLoop.setSetpoint(s.setpoint * 1000);
+	settingsChanged();
+}
+
+
+// Core 1 only runs the control loop: the sensor, the PID and the PWM.  No I2C, no heap, and its own
+// timer so nothing the UI does on core 0 can hold it up.
+void core1Main() {
+
+	HAL::timerInitCore();
+	bridge.init();
+#ifdef TEC_IRQ_LATENCY
+	bridge.measureLatency(true);
+#endif
+	// The loop's first tick should see a settled value.
+	adc.startOnPwm(SENSOR::CHANNEL_MASK, bridge.getSlice(), SENSOR::PWM_WRAPS_PER_SAMPLE, CONSTANT::PWM_FREQ);
+	while (!adc.ready()) {
+		adc.poll();
+		HAL::idle();
+	}
+	controlLoop.start(CONTROL::RATE_HZ);
+}
+
+
+// Before anything reads the settings.  How many were restored is SYSTem:SETTings?, the UART is the
+// console's.
+void initSettings() {
+	settingsLog.load();
+}
+
+
+void initControl() {
+
+	telemetry.init(PIN::TELEMETRY_TX, IO::TELEMETRY_BAUD);		// Its interrupts on core 0.
+	controlLoop.setGains(s.gains);
+	controlLoop.setSetpoint(s.setpoint * 1000);
+	HAL::launchCore1(core1Main);
 }
 
 
 void initI2C() {
 	
-	i2c_init(i2c1, I2C::I2CFREQ);
-	gpio_pull_up(PIN::SDA_PIN);
-	gpio_pull_up(PIN::SCL_PIN);
-	gpio_set_function(PIN::SDA_PIN, GPIO_FUNC_I2C);
-	gpio_set_function(PIN::SCL_PIN, GPIO_FUNC_I2C);
+	HAL::i2cInit(PIN::SDA_PIN, PIN::SCL_PIN, I2C::I2CFREQ);
 }
 
 
-void initDisplay(OBDISP& oled) {
+void initDisplay() {
 
-	while ( obdI2CInit(&oled, OLED::_128x64, OLED::ADDRESS, OLED::FLIP_180, OLED::INVERT, OLED::USE_HW_I2C, OLED::SDA_PIN, OLED::SCL_PIN, OLED::RESET_PIN, I2C::I2CFREQ, i2c1) < 0);
-	obdSetBackBuffer(&oled, bbuffer);
-	// sometimes oled isn't flipped so flip it again.
-	//if (!oled.flip) oled.flip;
+	HAL::displayInit();
+	HAL::displaySetBackBuffer(bbuffer);
 }
 
 
@@ -80,12 +193,260 @@ void initInputs() {
 }
 
 
+// The temperature as the control loop last measured it.  Only redrawn when it changes on screen.
+void refreshReadings() {
+
+	static int32_t shownTenths = INT32_MIN;
+	auto tenths = controlLoop.getMeasurement() / 100;
+	if (tenths == shownTenths) return;
+	shownTenths = tenths;
+	mainTemperature.set(Decimal::ratio(tenths, 10));
+	menuStack.current().refresh();
+}
+
+
+// Relay autotune around the current setpoint.  The PID keeps its gains until it has finished.
+void startAutotune() {
+
+	controlLoop.startAutotune({ CONTROL::TUNE_AMPLITUDE, CONTROL::TUNE_HYSTERESIS_MC, CONTROL::TUNE_LIMIT_MC,
+								CONTROL::TUNE_MAX_CYCLES, CONTROL::TUNE_TIMEOUT_S });
+}
+
+
+// Takes the gains an autotune found into the settings, once, when it finishes.  What it found is
+// PID:TUNE?, nothing is printed: the UART is the console's.
+void checkAutotune() {
+
+	static auto lastState = RelayTuner::State::Idle;
+	auto tuning = controlLoop.getStatus().tuning;
+	if (tuning.state == lastState) return;
+	lastState = tuning.state;
+
+	if (tuning.state == RelayTuner::State::Done) {
+		s.gains = tuning.gains;
+		controlLoop.setGains(s.gains);
+		settingsChanged();
+	}
+}
+
+
+// Commands from a host on the stdio UART, see Console.  They change the settings the way the
+// menus do, so the screen and flash keep up.
+namespace Commands {
+
+	using Args = Console::Args;
+	using Reply = Console::Reply;
+	using Number = Console::Number;
+	static_assert(std::is_same_v<Number, PID::Gain>);
+
+	void identify(const Args&, Reply& reply) { reply.add("TEC Controller"); }
+
+	void temperature(const Args&, Reply& reply) { reply.addScaled(controlLoop.getMeasurement(), 3); }
+
+	void output(const Args&, Reply& reply) { reply.addScaled(controlLoop.getOutput() * 1000 / 32767, 1); }	// %
+
+	// Whole degrees, as the menu has it.
+	void setSetpoint(const Args& args, Reply& reply) {
+
+		Number value;
+		if (!args.number(0, value)) {
+			reply.error("bad number");
+		} else if (!mainSetpoint.inRange(value.round())) {
+			reply.error("out of range");
+		} else {
+			mainSetpoint.set(value.round());
+		}
+	}
+
+	void setpoint(const Args&, Reply& reply) { reply.add(s.setpoint); }
+
+	template <PID::Gain PID::Gains::*field>
+	void setGain(const Args& args, Reply& reply) {
+
+		Number value;
+		if (!args.number(0, value)) {
+			reply.error("bad number");
+		} else if (value < 0 || value > PID::GAIN_MAX) {
+			reply.error("out of range");
+		} else {
+			s.gains.*field = value;
+			controlLoop.setGains(s.gains);
+			settingsChanged();
+		}
+	}
+
+	template <PID::Gain PID::Gains::*field>
+	void gain(const Args&, Reply& reply) { reply.add(s.gains.*field, 3); }
+
+	void tune(const Args&, Reply&) { startAutotune(); }
+
+	// The state and the cycles so far.  Once it's done, Ku, Tu in s, then the kp, ki and kd found.
+	void tuning(const Args&, Reply& reply) {
+
+		using State = RelayTuner::State;
+		auto tuning = controlLoop.getStatus().tuning;
+		switch (tuning.state) {
+			case State::Idle:		reply.add("IDLE"); break;
+			case State::Running:	reply.add("RUNNING"); break;
+			case State::Done:		reply.add("DONE"); break;
+			case State::Failed:		reply.add("FAILED"); break;
+		}
+		reply.add(",");
+		reply.add(tuning.cycles);
+		if (tuning.state != State::Done) return;
+		for (auto value : { tuning.ultimateGain, tuning.ultimatePeriodS, tuning.gains.kp, tuning.gains.ki, tuning.gains.kd }) {
+			reply.add(",");
+			reply.add(value, 3);
+		}
+	}
+
+	// Ticks, overruns, worst jitter and execution time in us.
+	void loop(const Args&, Reply& reply) {
+
+		auto stats = controlLoop.getStats();
+		reply.add(stats.ticks);
+		reply.add(",");
+		reply.add(stats.overruns);
+		reply.add(",");
+		reply.add(stats.maxJitterUs);
+		reply.add(",");
+		reply.add(stats.maxExecUs);
+	}
+
+	// Percent of the time asleep, wakes, mean and worst task latency in us.
+	void idle(const Args&, Reply& reply) {
+
+		auto stats = scheduler.getStats();
+		reply.addScaled(stats.elapsedUs ? stats.sleptUs * 1000 / stats.elapsedUs : 0, 1);
+		reply.add(",");
+		reply.add(stats.wakes);
+		reply.add(",");
+		reply.add(stats.timedRuns ? stats.totalLatencyUs / stats.timedRuns : 0);
+		reply.add(",");
+		reply.add(stats.maxLatencyUs);
+	}
+
+	// Settings restored at boot, saves, compactions and flash failures since.
+	void settings(const Args&, Reply& reply) {
+
+		auto stats = settingsLog.getStats();
+		reply.add(stats.restored);
+		reply.add(",");
+		reply.add(stats.saves);
+		reply.add(",");
+		reply.add(stats.compactions);
+		reply.add(",");
+		reply.add(stats.failures);
+	}
+
+	const Console::Command table[] {
+		{ "*IDN", nullptr, identify },
+		{ "MEASure:TEMPerature", nullptr, temperature },
+		{ "MEASure:OUTPut", nullptr, output },
+		{ "TEMPerature:SETpoint", setSetpoint, setpoint },
+		{ "PID:KP", setGain<&PID::Gains::kp>, gain<&PID::Gains::kp> },
+		{ "PID:KI", setGain<&PID::Gains::ki>, gain<&PID::Gains::ki> },
+		{ "PID:KD", setGain<&PID::Gains::kd>, gain<&PID::Gains::kd> },
+		{ "PID:DFILter", setGain<&PID::Gains::dFilterS>, gain<&PID::Gains::dFilterS> },
+		{ "PID:TUNE", tune, tuning },
+		{ "STATus:LOOP", nullptr, loop },
+		{ "STATus:IDLE", nullptr, idle },
+		{ "SYSTem:SETTings", nullptr, settings },
+	};
+}
+
+Console console { Commands::table };
+
+
+// The oldest event on either queue, so turns and presses are handled in the order they happened.
+bool nextInput(InputEvent& event) {
+
+	InputEvent turn, press;
+	bool haveTurn = encoderQueue.peek(turn);
+	bool havePress = buttonQueue.peek(press);
+	if (haveTurn && (!havePress || static_cast<int32_t>(turn.timeUs - press.timeUs) <= 0)) return encoderQueue.pop(event);
+	return havePress && buttonQueue.pop(event);
+}
+
+
+// Runs what the interrupts queued up.  Detents in a row are added up and drawn once, so a fast
+// spin costs one redraw however many events it made.  Anything else is handled in order.
+// A release only counts in the menu that saw the press, a long press that changed menu would
+// otherwise click whatever it landed on.
+void handleInput() {
+
+	static MainMenu* pressedIn = nullptr;
+	int detents = 0;
+	InputEvent event;
+	while (nextInput(event)) {
+		auto& menu = menuStack.current();
+		switch (event.type) {
+			case InputEvent::Type::Clockwise:		++detents; continue;
+			case InputEvent::Type::Anticlockwise:	--detents; continue;
+			default: break;
+		}
+		menu.scroll(detents);
+		detents = 0;
+		switch (event.type) {
+			case InputEvent::Type::ButtonDown:
+				pressedIn = &menu;
+				menu.enterButtonDown();
+				break;
+			case InputEvent::Type::ButtonUp:
+				if (pressedIn == &menu) menu.enterButtonUp();
+				pressedIn = nullptr;
+				break;
+			case InputEvent::Type::LongPress:	menu.enterButtonPressedLong(); break;
+			default: break;
+		}
+	}
+	menuStack.current().scroll(detents);
+	if (menuStack.current().animating()) scheduler.post(animationTask);
+}
+
+
+// The open menu's animations, a frame at a time.  The task only has a deadline while they run.
+void animate() {
+
+	auto now = HAL::timeUs();
+	auto next = menuStack.current().animate(now);
+	if (next != MainMenu::IDLE) scheduler.after(animationTask, next > now ? next - now : 0);
+}
+
+
+// Input as soon as the encoder's interrupts queue it, the console as soon as characters come in,
+// and the display once the DMA has finished with the last frame and can take anything held back.
+void initTasks() {
+
+	scheduler.add(handleInput, 0, [](){ return !encoderQueue.empty() || !buttonQueue.empty(); });
+	scheduler.add([](){
+		refreshReadings();
+		checkAutotune();
+	}, IO::READING_REFRESH_US);
+	// A save the flash failed is tried again a while later.
+	saveTask = scheduler.add([](){
+		settingsLog.service();
+		if (settingsLog.isPending()) scheduler.after(saveTask, STORE::SAVE_DELAY_US);
+	});
+	scheduler.add([](){ telemetry.service(); }, IO::TELEMETRY_SERVICE_US);
+	// A command can change what the menu shows, TEMP:SET does, so it's refreshed after each one.
+	consoleTask = scheduler.add([](){
+		bool more = console.service();
+		menuStack.current().refresh();
+		if (more) scheduler.post(consoleTask);
+	});
+	displayTask = scheduler.add([](){ display.flush(); });
+	animationTask = scheduler.add(animate);
+
+	frameBuffer.setFlushedFunction([](){ scheduler.post(displayTask); });
+	HAL::consoleSetInputCallback([](){ scheduler.post(consoleTask); });
+}
+
+
 void init() {
 
-	stdio_init_all();
-	for(int i = 0; i < 50; ++i) std::cout << std::endl;
+	HAL::stdioInit();
 	initI2C();
-//	initPWM();
 	initInputs();
 }
 
@@ -94,68 +455,64 @@ void init() {
 int main(int argc, const char* argv[]) {
 
 	init();
-	initDisplay(oled);
+	initSettings();
+	initDisplay();
 	
-	for(uint i{0}; i < 8; ++i) obdWriteString(&oled, 0, 0, i, (char*)"                ", FONT_8x8, false, true);
+	for(uint i{0}; i < 8; ++i) frameBuffer.writeString(0, i, "                ", HAL::FONT_8x8, false);
+	frameBuffer.flush();
 	
-	sleep_ms(750);
+	HAL::sleepMs(750);
 
-	obdWriteString(&oled, 0, 0, 2, (char*)"Up and running.", FONT_8x8, false, true);
+	frameBuffer.writeString(0, 2, "Up and running.", HAL::FONT_8x8, false);
+	frameBuffer.flush();
 
-	sleep_ms(1500);
+	HAL::sleepMs(1500);
 	
-	for(uint i{0}; i < 8; ++i) obdWriteString(&oled, 0, 0, i, (char*)"                ",FONT_8x8, false, true); 
-
-
-	std::vector<Menu> menus {
-		Menu { 
-			std::vector<std::shared_ptr<BasicMenuItem>> { 
-						std::make_shared<MenuTitle>("MENU"),
-						std::make_shared<MenuButton>("One", [&menus](){
-							currentMenu->closeMenu();
-							currentMenu = std::make_unique<Menu>(menus[1]);
-						}),
-						std::make_shared<MenuSetting<int>>("Spd:", s.speed, 0, 200, true),
-						std::make_shared<MenuButton>("Three"),
-						std::make_shared<MenuButton>("Four") },
-			128,
-			64,
-			8,
-			8,
-			1,
-			MenuUtils::Alignment::Center 
-		},
-
-
-		Menu {
-			std::vector<std::shared_ptr<BasicMenuItem>> {
-				std::make_shared<MenuTitle>("MENU 2"),
-				std::make_shared<MenuButton>("Say Hi"),
-				std::make_shared<MenuButton>("Say Ho"),
-				std::make_shared<MenuButton>("Say No") },
-			128,
-			64,
-			12,
-			16,
-			FONT_12x16,
-			MenuUtils::Alignment::Center,
-			1,
-			[&menus](){ 
-				currentMenu->closeMenu();
-				currentMenu = std::make_unique<Menu>(menus[0]);
-			}
-		}
-	};
+	for(uint i{0}; i < 8; ++i) frameBuffer.writeString(0, i, "                ", HAL::FONT_8x8, false); 
+	frameBuffer.flush();
 
 
-	currentMenu = std::make_unique<Menu>(Menu(menus[0]));
-	while (1) {
+	initControl();
 
-		RotaryEncoder r1 = RotaryEncoder(PIN::ENCODER_PIN1, PIN::ENCODER_PIN2, PIN::ENCODER_BUTTON_PIN, [](){ currentMenu->upButton(); }, [](){ currentMenu->downButton(); },[](){ currentMenu->enterButtonDown(); } , [](){ currentMenu->enterButtonUp(); }, [](){ currentMenu->enterButtonPressedLong(); } );
-		
-		(*currentMenu)();
-	}
+	// The interrupts only queue events, the menus run here.
+	RotaryEncoder r1 { PIN::ENCODER_PIN1, PIN::ENCODER_PIN2, PIN::ENCODER_BUTTON_PIN, encoderQueue, buttonQueue };
+
+	menuStack.push(mainMenu);
+	initTasks();
+	if (menuStack.current().animating()) scheduler.post(animationTask);
+
+#ifdef TEC_IRQ_LATENCY
+	static LatencyProbe probe { PIN::LATENCY_PROBE };
+	scheduler.add([](){ probe.toggle(); }, IO::LATENCY_PROBE_US);
+	scheduler.add([](){
+		auto& latency = IrqLatency::stats();
+		if (latency.count) {
+			std::cout << "irq latency: " << latency.count << " edges, min " << latency.minUs << " us, mean "
+					  << latency.totalUs / latency.count << " us, max " << latency.maxUs << " us" << std::endl;
+		}
+		auto pwm = bridge.getLatency();
+		if (pwm.updates) {
+			std::cout << "pwm update latency: " << pwm.updates << " updates, mean " << pwm.totalUs / pwm.updates
+					  << " us, max " << pwm.maxUs << " us" << std::endl;
+		}
+		auto sampling = adc.getStats();
+		if (sampling.elapsedUs) {
+			std::cout << "adc: " << sampling.samples * 1'000'000 / sampling.elapsedUs << " samples/s, filter "
+					  << sampling.busyUs * 100.0 / sampling.elapsedUs << " % cpu, " << sampling.overruns << " overruns" << std::endl;
+		}
+		auto sent = telemetry.getStats();
+		std::cout << "telemetry: " << sent.frames << " frames, " << sent.dropped << " dropped, " << sent.bytes << " bytes sent" << std::endl;
+		auto lines = lineCache.getStats();
+		std::cout << "line cache: " << lines.hits << " hits, " << lines.misses << " misses, " << lines.evictions << " evictions" << std::endl;
+		auto tasks = scheduler.getStats();
+		if (tasks.elapsedUs && tasks.timedRuns) {
+			std::cout << "core 0: " << tasks.sleptUs * 100.0 / tasks.elapsedUs << " % asleep, " << tasks.wakes << " wakes, task latency mean "
+					  << tasks.totalLatencyUs / tasks.timedRuns << " us, max " << tasks.maxLatencyUs << " us" << std::endl;
+		}
+	}, IO::LATENCY_REPORT_US);
+#endif
 
+	scheduler.run();
 	return 0;
 }
 
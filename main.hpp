@@ -2,8 +2,9 @@
 #define __MAIN_HPP
 
 
-#include "pico/stdlib.h"
-#include "OLED/oneBitDisplay.h"
+#include "hal.hpp"
+#include "thermistor.hpp"
+#include "fixed.hpp"
 
 
 
@@ -15,11 +16,18 @@ namespace PIN {
 	inline constexpr uint8_t ENCODER_PIN1 		{ 18 };
 	inline constexpr uint8_t ENCODER_PIN2		{ 17 };
 	inline constexpr uint8_t ENCODER_BUTTON_PIN { 16 };
+	inline constexpr uint8_t TELEMETRY_TX		{ 4 };	// UART1, stdio has UART0.
+	inline constexpr uint8_t LATENCY_PROBE		{ 22 };	// Free pin toggled when built with TEC_IRQ_LATENCY.
 }
 
 namespace IO {
 //	inline constexpr uint8_t PULSES_PER_DETENT	{ 1 };
 	inline constexpr uint16_t DEBOUNCE_MS		{ 1 };
+	inline constexpr uint32_t LATENCY_PROBE_US	{ 10'000 };
+	inline constexpr uint32_t LATENCY_REPORT_US	{ 1'000'000 };
+	inline constexpr uint32_t READING_REFRESH_US	{ 250'000 };
+	inline constexpr uint32_t TELEMETRY_BAUD	{ 921'600 };	// A 31 byte frame per tick needs 310k at 1 kHz.
+	inline constexpr uint32_t TELEMETRY_SERVICE_US	{ 10'000 };	// Restarts the DMA.  The ring holds 130 ms.
 }
 
 namespace OLED {
@@ -31,6 +39,7 @@ namespace OLED {
 	inline constexpr bool INVERT      { false };
 	inline constexpr bool USE_HW_I2C  { true };
 	inline constexpr uint8_t _128x64  { 3 };
+	inline constexpr uint LINE_CACHE_BYTES { 2048 };	// Rendered menu lines, see LineCache.  A full 8x8 line is 128.
 }
 
 namespace CONSTANT {
@@ -41,6 +50,53 @@ namespace CONSTANT {
 	inline constexpr uint32_t PWM_WRAP_VAL_PHASE   { PWM_WRAP_VAL_NOPHASE / 2 };
 	inline constexpr double DEAD_TIME_S            { 1024e-9 };
 	inline constexpr uint16_t DEAD_TIME_CYCL	   { static_cast<uint16_t>(DEAD_TIME_S / PWM_CLK_PERIOD) }; 
+	inline constexpr double MIN_PULSE_S            { 200e-9 };
+	inline constexpr uint16_t MIN_PULSE_CYCL	   { static_cast<uint16_t>(MIN_PULSE_S / PWM_CLK_PERIOD) };
+}
+
+// Sensor inputs, all captured together by the ADC.
+namespace SENSOR {
+	inline constexpr uint TEMPERATURE_CHANNEL	{ 0 };		// GPIO 26, thermistor.
+	inline constexpr uint CURRENT_CHANNEL		{ 1 };		// GPIO 27, TEC current sense.
+	inline constexpr uint SUPPLY_CHANNEL		{ 3 };		// GPIO 29, VSYS / 3 on the Pico.
+	inline constexpr uint32_t CHANNEL_MASK		{ 1u << TEMPERATURE_CHANNEL | 1u << CURRENT_CHANNEL | 1u << SUPPLY_CHANNEL };
+	inline constexpr uint CHANNELS				{ 3 };
+
+	// 10k NTC, B 3950, under a 10k resistor to the ADC reference.
+	inline constexpr Thermistor::Circuit<Thermistor::Beta> THERMISTOR { { 10'000, 25, 3'950 }, 10'000, -40, 125 };
+	inline constexpr int32_t CURRENT_SPAN_MA	{ 10'000 };		// -5 A to +5 A, zero at mid scale.
+	inline constexpr int32_t SUPPLY_SPAN_MV		{ 9'900 };		// 3 * 3.3 V.
+
+	// Conversions start on the bridge's PWM wraps, one every PWM_WRAPS_PER_SAMPLE, so the current is
+	// always sampled mid pulse, away from the switching edges.  Each channel is then filtered by a
+	// CIC of CIC_ORDER and decimated by DECIMATION, which with 3 channels at 100 ksps gives a value
+	// every 0.96 ms, a little faster than the control rate.
+	inline constexpr uint PWM_WRAPS_PER_SAMPLE	{ 2 };
+	inline constexpr uint CIC_ORDER				{ 2 };
+	inline constexpr uint DECIMATION			{ 32 };
+	inline constexpr size_t RING_SAMPLES		{ 510 };		// A multiple of CHANNELS, 5 ms.
+}
+
+namespace CONTROL {
+	inline constexpr uint RATE_HZ				{ 1'000 };
+	using Gain = Fixed<15, 16>;						// As PID::Gain.
+	inline constexpr Gain KP					{ 0.5 };	// Full scale per degree.
+	inline constexpr Gain KI					{ 0.05 };
+	inline constexpr Gain KD					{ 0.0 };
+	inline constexpr Gain D_FILTER_S			{ 0.01 };
+
+	// Autotune, see RelayTuner.  The relay swings the output 20 % of full scale either side of
+	// where the PID had it.
+	inline constexpr int32_t TUNE_AMPLITUDE		{ 6'554 };
+	inline constexpr int32_t TUNE_HYSTERESIS_MC	{ 50 };		// A few times the reading's noise.
+	inline constexpr int32_t TUNE_LIMIT_MC		{ 5'000 };
+	inline constexpr uint32_t TUNE_MAX_CYCLES	{ 20 };
+	inline constexpr uint32_t TUNE_TIMEOUT_S	{ 1'800 };
+}
+
+// Settings in flash, see SettingsLog.
+namespace STORE {
+	inline constexpr uint64_t SAVE_DELAY_US		{ 2'000'000 };	// After the last change, so a spin of the knob is one write.
 }
 
 namespace I2C {
@@ -49,7 +105,17 @@ namespace I2C {
 
 void init();
 void initI2C();
-void initDisplay(OBDISP& oled);
-void initPWM();
+void initDisplay();
+void initControl();
+void initSettings();
+void initTasks();
+void settingsChanged();
+void setpointChanged();
+void core1Main();
+int32_t readTemperature();
+void handleInput();
+void refreshReadings();
+void startAutotune();
+void checkAutotune();
 
 #endif // __MAIN_HPP
\ No newline at end of file
@@ -1,13 +1,14 @@
 #ifndef _MENU_HPP__
 #define _MENU_HPP__
 
-#include "pico/stdlib.h"
-#include <vector>
-#include <string>
+#include "hal.hpp"
+#include "format.hpp"
+#include "animation.hpp"
+#include <array>
 #include <functional>
-#include <memory>
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 
 #pragma message "TODO: Add new features."
@@ -20,6 +21,11 @@ namespace MenuUtils {
 	enum class Alignment {
 		Left, Center, Right
 	};
+
+	inline constexpr uint MAX_COLUMNS { 21 };	// 128 pixels of the narrowest font.
+	inline constexpr uint BLINK_FRAMES { 7 };		// Flashing the item that was clicked.
+	inline constexpr uint32_t BLINK_FRAME_US { 75'000 };
+	inline constexpr uint32_t MARQUEE_STEP_US { 300'000 };	// A selected label too wide for the screen.
 }
 
 
@@ -34,12 +40,12 @@ private:
 	volatile bool dirty;
 
 protected:
-	std::string content; // Mutable so as it can be aligned by the menu.
-	BasicMenuItem(const std::string& content) : dirty(true), content(content) {}
+	char content[MenuUtils::MAX_COLUMNS + 1]; // Mutable so as it can be aligned by the menu.
+	BasicMenuItem(const char* content);
 	virtual ~BasicMenuItem() {}
 
 public:
-	std::string& getContent() { return content; }
+	const char* getContent() const { return content; }
 
 	virtual bool selectable() const = 0;
 	virtual bool scrollable() const = 0;
@@ -61,7 +67,7 @@ class MenuButton : public BasicMenuItem {
 	std::function<void()> buttonUpFunction;
 
 public:
-	MenuButton(const std::string& content, const std::function<void()>& onClick = {}) : 
+	MenuButton(const char* content, const std::function<void()>& onClick = {}) : 
 		BasicMenuItem(content),
 		onClick(onClick)
 	{}
@@ -76,7 +82,7 @@ class MenuTitle : public BasicMenuItem {
 
 
 public:
-	MenuTitle(const std::string& content) :
+	MenuTitle(const char* content) :
 		BasicMenuItem(content)
 	{}
 	bool selectable() const override { return false; }
@@ -86,7 +92,6 @@ public:
 
 
 
-#pragma message "TODO: specialize for double and float so that only they have nDecimal places"
 template <typename T>
 class MenuSetting : public BasicMenuItem {
 
@@ -94,76 +99,79 @@ class MenuSetting : public BasicMenuItem {
 	const T min, max;
 	const bool showSign;
 	const uint8_t nDecimalPlaces;
+	const uint nameLength;	// The value is written after this.
+	std::function<void()> onChange;
 
 public:
-	MenuSetting(const std::string& name, T& settingRef, const T min, const T max, bool showSign = false, const uint8_t nDecimalPlaces = 0) : 
+	MenuSetting(const char* name, T& settingRef, const T min, const T max, bool showSign = false, const uint8_t nDecimalPlaces = 0, const std::function<void()>& onChange = {}) : 
 		BasicMenuItem(name),
 		settingRef(settingRef),
 		min(min),
 		max(max),
 		showSign(showSign),
-		nDecimalPlaces(nDecimalPlaces)
+		nDecimalPlaces(nDecimalPlaces),
+		nameLength(std::strlen(name)),
+		onChange(onChange)
 	{}
 
 	void align(const uint screenWidth, const MenuUtils::Alignment alignment) override;
 
+	// Clamped to min and max, and redrawn with the menu's next refresh.  onChange only hears of it
+	// if it really changed.
+	void set(const T& value) {
+		auto clamped = std::clamp(value, min, max);
+		if (clamped == settingRef) return;
+		settingRef = clamped;
+		markDirty();
+		if (onChange) onChange();
+	}
+	const T& get() const { return settingRef; }
+	bool inRange(const T& value) const { return value >= min && value <= max; }
+
 	bool selectable() const override { return true; }
 	bool scrollable() const override { return true; }
 	//void operator()() const {  if (onClick) onClick(); }
 };
 
 
-#include <iostream>
 template <typename T>
 void MenuSetting<T>::align(const uint screenWidth, const MenuUtils::Alignment alignment) {
-	// ignore aligment for this one we will just stick content on the right and the value on the left.
+	// ignore aligment for this one we will just stick the name on the left and the value on the right.
 	BasicMenuItem::align(screenWidth, MenuUtils::Alignment::Left);  // aligns the title.
-	std::stringstream stream;
-	if (showSign) stream << std::showpos;
-	stream << std::fixed << std::setprecision(nDecimalPlaces) << settingRef << std::endl;
-	std::string val;
-	stream >> val;
-	// std::cout << "Content length: " << content.length() << std::endl;
-	// std::cout << "Content: " << content << ".\n";
-	// std::cout << "val: " << std::showpos << val << std::endl;
-	//content.insert(content.length(), std::string(screenWidth - content.length' '));
-	content.insert(content.length() - val.length(), val);
+	uint length = std::strlen(content);
+	if (nameLength >= length) return;
+	// The value goes straight into the line, no temporary strings.
+	Format::rightAligned(&content[nameLength], length - nameLength, settingRef, showSign, nDecimalPlaces);
 }
 
 
 
 
-// Example of how to initialize menu drawing functions.
-
-// #include <functional>
-
-// const std::function<void(std::string, int, bool)> Menu::drawLineFunction { 
-// 	[](std::string str, int yPos, bool inv){ 
-//  		obdWriteString(&oled, false, 0, yPos, const_cast<char*>(str.c_str()), FONT_8x8, inv, true); 
-// }};
-
-// const std::function<void(int,int,int,int,uint8_t,uint8_t)> Menu::drawRectangleFunction {
-// 	[](int x1, int y1, int x2, int y2, uint8_t colour, uint8_t filled) {
-//  		obdRectangle(&oled, x1, y1, x2, y2, colour, filled);
-// }};
+namespace MenuUtils {
+	// A menu's items, kept in a static array elsewhere.  Menus point at them, they don't own or copy them.
+	class Items {
+		BasicMenuItem* const* first;
+		uint count;
+	public:
+		template <size_t N>
+		constexpr Items(BasicMenuItem* const (&items)[N]) : first(items), count(N) {}
+
+		BasicMenuItem* const* begin() const { return first; }
+		BasicMenuItem* const* end() const { return first + count; }
+		uint size() const { return count; }
+		BasicMenuItem* operator[](uint i) const { return first[i]; }
+	};
+}
 
-// const std::function<void()> Menu::dumpBufferFunction {
-// 		[]() { obdDumpBuffer(&oled, bbuffer);
-// }};
 
 
 
+// Display is one of the backends in display.hpp, chosen at compile time so drawing calls inline.
+template <typename Display>
 class Menu {
 
-public:
-
-// Set these globally.
-	const static std::function<void(std::string&, int yPos, bool inverted, int fontCmd)> drawLineFunction;
-	const static std::function<void(int x1, int y1, int x2, int y2, uint8_t colour, uint8_t filled)> drawRectangleFunction;
-	const static std::function<void()> dumpBufferFunction;
-
-private:
-	std::vector<std::shared_ptr<BasicMenuItem>> items;
+	Display& display;
+	const MenuUtils::Items items;
 	const uint widthColumns;	// width of screen in characters.
 	const uint heightRows;	// height of screen in characters
 	const uint widthPixels;
@@ -181,27 +189,30 @@ private:
 	
 	bool ignoreRotary;
 	bool ignoreButton;
-	bool closing; // Breaks out of the operator() loop.
 
 	std::function<void()> enterButtonLongPressFunc; // What to do on a long press.  This is not for a particular item but for the whole menu.
 
+	Animator<Display> animator;		// Only ticked while this is the open menu.
+
 	// set the menu to ignore input of certain types.
 
 	void align(BasicMenuItem& item, MenuUtils::Alignment how);
 	void draw();					// Redraw the menu. Could be public.
-	void drawFuncsInitialised();	// Allow to assert menu initialized properly.
 	void markAllDirty();			// Menu only draws dirty items.
+	void shift(int rows);			// Scrolls the display with the items, positive is up.
+	void stepDown();				// Move the selection without drawing.
+	void stepUp();
+	bool startMarquee(uint64_t nowUs);	// On the selection, if it's too wide to show.
 
 
 public:
-// Initialize with vector of menu items shared_ptr.
+// Initialize with the display to draw on.
+// the menu items.
 // width and height.
-// the drawline function of your display library wrapped to allow same args.
-// the drawRectangle function of your display library wrapped.
-// the dumpBuffer function of your display library. optional.
 // desired menu alignment
 // desired start pos of menu.
-	Menu(	std::vector<std::shared_ptr<BasicMenuItem>> items,
+	Menu(	Display& display,
+			MenuUtils::Items items,
 		 	uint widthPixels,
 			uint heightPixels,
 			uint fontWidth,
@@ -212,21 +223,325 @@ public:
 			std::function<void()> longPressFunc = {}
 		);
 
-	Menu(uint widthPixels, uint heightPixels, uint fontWidth, uint fontHeight, int fontCmd, MenuUtils::Alignment alignment, int startIndex);
-	//Menu();
-	//Menu(const Menu& other);
-
-	void addItem(const std::shared_ptr<BasicMenuItem>& item);
-	void addItems(const std::vector<std::shared_ptr<BasicMenuItem>>& items);
+	Menu(const Menu& other) = delete;	// Menus live in one place, navigate with MenuStack.
 
 	int downButton();
 	int upButton();
+	int scroll(int detents);		// Positive is down.  Moves that far and draws once.
 	int enterButtonDown();
 	int enterButtonUp();
 	int enterButtonPressedLong();
 
-	void operator()();  // Runs the menu in a loop.
-	void closeMenu() { closing = true; } // Breaks out of the loop.
+	void open();		// Draw the whole menu and start taking input.
+	void refresh();		// Redraw the items marked dirty since, with their values as they are now.
+
+	// From a timer while animating() says so.  Returns when it next wants to be called, or IDLE.
+	static constexpr uint64_t IDLE { Animator<Display>::IDLE };
+	uint64_t animate(uint64_t nowUs);
+	bool animating() const { return animator.active(); }
+};
+
+
+
+// Menu
+
+template <typename Display>
+Menu<Display>::Menu(Display& display, MenuUtils::Items items, uint widthPixels, uint heightPixels, uint fontWidth, uint fontHeight, int fontCmd, MenuUtils::Alignment alignment, int startIndex, std::function<void()> longPressFunc) :
+				display(display),
+				items(items),
+				widthColumns(ceil(static_cast<float>(widthPixels) / static_cast<float>(fontWidth))),
+				heightRows(ceil(static_cast<float>(heightPixels) / static_cast<float>(fontHeight))),
+				widthPixels(widthPixels),
+				heightPixels(heightPixels),
+				fontWidth(fontWidth),
+				fontHeight(fontHeight),
+				fontCmd(fontCmd),
+				byteRowsPerCharacter(fontHeight / 8),
+				titleHeight(std::count_if(items.begin(), items.end(), [](auto& item)->bool{ return dynamic_cast<MenuTitle*>(item) != nullptr; })),
+				alignment(alignment),
+				index((startIndex < 0) ? titleHeight : startIndex),  
+				screenTopItOffs(titleHeight),
+				screenBottomItOffs(screenTopItOffs + heightRows - screenTopItOffs),
+				ignoreRotary(false),
+				ignoreButton(false),
+				enterButtonLongPressFunc(longPressFunc),
+				animator(display, widthPixels) {
+
+	static_assert(Animator<Display>::MAX_COLUMNS == MenuUtils::MAX_COLUMNS);
+	for (auto&& item : this->items) { align(*item, alignment); }
+}
+
+template <typename Display>
+void Menu<Display>::open() {
+
+	ignoreRotary = false;
+	ignoreButton = false;
+	animator.stopAll();		// Whatever was left running when another menu opened over this one.
+
+	// With the values as they are now, not as they were when it was made.  The menus are made
+	// before the settings are loaded, and a setting can change while another menu is open.
+	for (auto item : items) {
+		align(*item, alignment);
+		item->markDirty();
+	}
+
+	draw();
+	startMarquee(HAL::timeUs());
+}
+
+
+// Not while the button is down, it would draw over the press.  The items stay dirty until later.
+template <typename Display>
+void Menu<Display>::refresh() {
+
+	if (ignoreRotary) return;
+	for (auto item : items) {
+		if (item->isDirty()) align(*item, alignment);
+	}
+	draw();
+}
+
+
+template <typename Display>
+void Menu<Display>::align(BasicMenuItem& item, MenuUtils::Alignment how) {
+
+	item.align(widthColumns, how);
+}
+
+
+template <typename Display>
+void Menu<Display>::draw() {
+
+// Draw any title lines at the top.
+	for (auto titleIt = items.begin(); titleIt != items.begin() + titleHeight; ++titleIt) {
+		if ((*titleIt)->isDirty()) {
+
+			auto row = (titleIt - items.begin()) * byteRowsPerCharacter;
+			display.drawLine((*titleIt)->getContent(), row, false, fontCmd);
+			(*titleIt)->markClean();
+		}
+	}
+	// This is for the items.  Between top and bottom it.
+	auto screenTopIt = std::next(std::begin(items), screenTopItOffs);
+	auto screenBottomIt = std::next(std::begin(items), screenBottomItOffs);
+
+	for (auto it = screenTopIt; it != screenBottomIt; ++it) {
+		
+		auto itemNumber = it - screenTopIt + titleHeight;
+		auto row = itemNumber * byteRowsPerCharacter;		// get scrn pos.
+
+		// Check that there is an item.
+		if (itemNumber >= items.size()) {
+
+			char blankLine[MenuUtils::MAX_COLUMNS + 1];
+			uint columns = std::min(widthColumns, MenuUtils::MAX_COLUMNS);
+			std::memset(blankLine, ' ', columns);
+			blankLine[columns] = '\0';
+			display.drawLine(blankLine, row, false, fontCmd);
+			continue;
+		}
+		// Draw if dirty.
+		auto& item = **it;
+
+		if (item.isDirty()) {
+
+			display.drawLine(item.getContent(), row, row == index * byteRowsPerCharacter, fontCmd);
+			item.markClean();
+		}
+	}
+	display.flush();	// Sends whatever changed as one flush.
+}
+
+
+template <typename Display>
+void Menu<Display>::markAllDirty() { 
+	for (uint i = titleHeight; i < items.size(); ++i) { items[i]->markDirty(); }
+}
+
+
+template <typename Display>
+void Menu<Display>::stepDown() {
+
+	// index is above bottom. // and bottom isn't midway through the screen.
+	if (index < static_cast<int>(heightRows - 1) && index < static_cast<int>(items.size() - 1)) {
+		items[screenTopItOffs + index - 1]->markDirty();
+		items[screenTopItOffs + index++]->markDirty();
+		
+	// if index is at bottom of screen and there are more items.
+	} else if (/*index == height - 1 && */screenBottomItOffs < items.size()) {
+		screenTopItOffs++;
+		screenBottomItOffs++;
+		shift(1);
+	}
+}
+
+
+template <typename Display>
+void Menu<Display>::stepUp() {
+
+// Scroll the index up if possibe.
+	if (index > static_cast<int>(titleHeight)) {
+		items[screenTopItOffs + --index]->markDirty();
+		items[screenTopItOffs + index - 1]->markDirty();
+		
+	} else if (screenTopItOffs > titleHeight) {
+		screenTopItOffs--;
+		screenBottomItOffs--;
+		shift(-1);
+	}
+}
+
+
+// The display moves what it shows, so only the rows that change are drawn again: the titles,
+// which moved with everything else, the row it uncovered and the selection, which stays put on
+// the screen while the items go past it.
+template <typename Display>
+void Menu<Display>::shift(int rows) {
+
+	display.scroll(rows * static_cast<int>(byteRowsPerCharacter));
+	for (uint i = 0; i < titleHeight; ++i) items[i]->markDirty();
+
+	int uncovered = rows > 0 ? heightRows - 1 : titleHeight;
+	for (int row : { uncovered, static_cast<int>(index), index - rows }) {
+		uint itemNumber = row - titleHeight + screenTopItOffs;
+		if (row >= static_cast<int>(titleHeight) && row < static_cast<int>(heightRows) && itemNumber < items.size())
+			items[itemNumber]->markDirty();
+	}
+}
+
+
+template <typename Display>
+int Menu<Display>::downButton() { return scroll(1); }
+
+
+template <typename Display>
+int Menu<Display>::upButton() { return scroll(-1); }
+
+
+template <typename Display>
+int Menu<Display>::scroll(int detents) {
+
+	if (ignoreRotary || detents == 0) return 0;
+
+	// Moving the selection redraws the rows either side, this puts back the one that was flashing
+	// if it can't move.
+	if (animator.active()) {
+		items[index - titleHeight + screenTopItOffs]->markDirty();
+		animator.stopAll();
+	}
+	for (; detents > 0; --detents) stepDown();
+	for (; detents < 0; ++detents) stepUp();
+	draw();
+	startMarquee(HAL::timeUs());
+	return 1;
+}
+
+
+// Starts from the label's beginning, as draw() left it.  Not while the button is down, the row is
+// showing the press.
+template <typename Display>
+bool Menu<Display>::startMarquee(uint64_t nowUs) {
+
+	if (ignoreRotary) return false;
+	auto itemNumber = index - titleHeight + screenTopItOffs;
+	if (itemNumber >= items.size()) return false;
+	auto content = items[itemNumber]->getContent();
+	if (std::strlen(content) <= widthColumns) return false;
+	return animator.marquee(index * byteRowsPerCharacter, content, fontCmd, widthColumns, MenuUtils::MARQUEE_STEP_US, true, nowUs) >= 0;
+}
+
+
+// A click's blink replaces the selection's marquee, which starts again once it has finished.
+template <typename Display>
+uint64_t Menu<Display>::animate(uint64_t nowUs) {
+
+	auto next = animator.tick(nowUs);
+	if (!animator.active() && startMarquee(nowUs)) next = animator.tick(nowUs);
+	return next;
+}
+
+
+template <typename Display>
+int Menu<Display>::enterButtonDown() {
+
+	if (ignoreButton) return 0;
+	ignoreRotary  = true;
+
+	// Item you are pointing at = index - titleHeight + screenTopItOffset
+	auto itemNumber = index - titleHeight + screenTopItOffs;
+	auto itemIt = std::next(std::begin(items), itemNumber);
+
+	// Index is your position on the screen relative to number of drawn rows for font size.
+	// The row on the screen.
+	auto row = index * byteRowsPerCharacter;	
+
+	animator.stopRow(row);
+	display.drawLine((*itemIt)->getContent(), row, false, fontCmd);
+
+	display.drawRectangle(1, row * 8, widthPixels - 1, ((row + byteRowsPerCharacter) * 8) - 1, 255, false);
+
+	display.flush();
+
+	return 1;
+}
+
+
+template <typename Display>
+int Menu<Display>::enterButtonUp() {
+
+	if (ignoreButton) return 0;
+	ignoreRotary = false;
+
+	auto itemNumber = index - titleHeight + screenTopItOffs;
+	auto itemIt = std::next(std::begin(items), itemNumber);
+	auto row = index * byteRowsPerCharacter;	
+
+	// The flash finishes from animate(), the click doesn't wait for it.  It ends selected.
+	animator.blink(row, (*itemIt)->getContent(), fontCmd, MenuUtils::BLINK_FRAMES, MenuUtils::BLINK_FRAME_US, true, HAL::timeUs());
+	if (auto button = dynamic_cast<MenuButton*>(*itemIt)) (*button)();
+	return 1;
+}
+
+
+template <typename Display>
+int Menu<Display>::enterButtonPressedLong() {
+
+	if (enterButtonLongPressFunc)
+		enterButtonLongPressFunc();
+
+	return 1;
+}
+
+
+
+
+// MenuStack
+// Where you are in the menus.  Going to another menu just moves a pointer and redraws, nothing is
+// copied or allocated.
+
+template <typename Display, uint DEPTH = 4>
+class MenuStack {
+
+	std::array<Menu<Display>*, DEPTH> stack;
+	uint depth;
+
+public:
+	MenuStack() : stack(), depth(0) {}
+
+	Menu<Display>& current() { return *stack[depth - 1]; }
+	bool empty() const { return depth == 0; }
+
+	void push(Menu<Display>& menu) {
+		if (depth == DEPTH) return;
+		stack[depth++] = &menu;
+		menu.open();
+	}
+
+	void pop() {
+		if (depth < 2) return;	// Stay on the top menu.
+		--depth;
+		current().open();
+	}
 };
 
 
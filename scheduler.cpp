@@ -0,0 +1,99 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+
+Scheduler::Scheduler() : tasks(), count(0), statsStartUs(0), stats() {}
+
+
+Scheduler::TaskID Scheduler::add(Run run, uint32_t periodUs, Ready ready) {
+
+	if (count == MAX_TASKS) return MAX_TASKS;
+	tasks[count] = Task { run, ready, periodUs, periodUs ? HAL::timeUs() + periodUs : NEVER, false, 0 };
+	return count++;
+}
+
+
+void Scheduler::after(TaskID task, uint32_t delayUs) {
+	if (task < count) tasks[task].dueUs = HAL::timeUs() + delayUs;
+}
+
+
+void Scheduler::post(TaskID task) {
+
+	if (task >= count || tasks[task].posted) return;
+	tasks[task].postedUs = HAL::timeUs();
+	tasks[task].posted = true;
+}
+
+
+void Scheduler::runDue() {
+
+	auto now = HAL::timeUs();
+	for (uint i = 0; i < count; ++i) {
+		auto& task = tasks[i];
+		uint64_t since = NEVER;
+		if (task.posted) {
+			since = task.postedUs;
+			task.posted = false;		// A post from here on runs it again.
+		}
+		if (task.dueUs <= now) {
+			since = std::min(since, task.dueUs);
+			// Missed periods are skipped, not made up.
+			task.dueUs = task.periodUs ? std::max(task.dueUs + task.periodUs, now + 1) : NEVER;
+		}
+		if (since == NEVER && !(task.ready && task.ready())) continue;
+
+		auto start = HAL::timeUs();
+		if (since != NEVER) {
+			uint32_t latency = start > since ? start - since : 0;
+			++stats.timedRuns;
+			stats.totalLatencyUs += latency;
+			stats.maxLatencyUs = std::max(stats.maxLatencyUs, latency);
+		}
+		++stats.runs;
+		task.run();
+	}
+}
+
+
+uint64_t Scheduler::nextWake() const {
+
+	uint64_t wake = NEVER;
+	for (uint i = 0; i < count; ++i) {
+		auto& task = tasks[i];
+		if (task.posted || (task.ready && task.ready())) return 0;
+		wake = std::min(wake, task.dueUs);
+	}
+	return wake;
+}
+
+
+void Scheduler::run() {
+
+	resetStats();
+	for (;;) {
+		runDue();
+		auto wake = nextWake();
+		auto start = HAL::timeUs();
+		if (wake <= start) continue;
+		// An interrupt from here on still wakes it straight away.
+		HAL::sleepUntil(wake);
+		++stats.wakes;
+		stats.sleptUs += HAL::timeUs() - start;
+	}
+}
+
+
+Scheduler::Stats Scheduler::getStats() const {
+
+	auto s = stats;
+	s.elapsedUs = HAL::timeUs() - statsStartUs;
+	return s;
+}
+
+
+void Scheduler::resetStats() {
+	stats = Stats {};
+	statsStartUs = HAL::timeUs();
+}
@@ -0,0 +1,75 @@
+#ifndef _SCHEDULER_HPP__
+#define _SCHEDULER_HPP__
+
+// Core 0's main loop.  Deferred work is registered as tasks, and between them the core sleeps
+// until the next deadline or interrupt instead of spinning.
+//
+// A task runs when its deadline passes, when something posts it, or when its ready() says so.
+// Deadlines repeat for a task with a period and are one off otherwise.  Posting is for
+// interrupts and for tasks that have more to do; ready() is checked on every wake and has to be
+// cheap, like looking at a queue.  Each wake runs every task that is due once, in the order they
+// were added, so no task can starve the others.
+//
+// Latency is from a task's deadline or its first post to it starting.  It covers the wake up and
+// any tasks ahead of it.
+
+#include "hal.hpp"
+
+#include <array>
+
+
+class Scheduler {
+
+public:
+	using Run = void (*)();
+	using Ready = bool (*)();
+	using TaskID = uint;
+
+	static constexpr uint MAX_TASKS { 12 };
+	static constexpr uint64_t NEVER { UINT64_MAX };
+
+	struct Stats {
+		uint64_t elapsedUs;		// Since the stats were reset.
+		uint64_t sleptUs;
+		uint32_t wakes;
+		uint32_t runs;
+		uint32_t timedRuns;		// Ones with a deadline or a post, which the latency is over.
+		uint64_t totalLatencyUs;
+		uint32_t maxLatencyUs;
+	};
+
+private:
+	struct Task {
+		Run run;
+		Ready ready;
+		uint32_t periodUs;
+		uint64_t dueUs;
+		volatile bool posted;
+		uint64_t postedUs;			// Written before posted is set.
+	};
+
+	std::array<Task, MAX_TASKS> tasks;
+	uint count;
+	uint64_t statsStartUs;
+	Stats stats;
+
+	void runDue();
+	uint64_t nextWake() const;		// 0 if something can run now.
+
+public:
+	Scheduler();
+
+	// Returns its ID, or MAX_TASKS when full, which the other calls ignore.  The first deadline is
+	// a period from now.
+	TaskID add(Run run, uint32_t periodUs = 0, Ready ready = nullptr);
+
+	void after(TaskID task, uint32_t delayUs);		// Moves its next deadline.
+	void post(TaskID task);			// Core 0, tasks or interrupts.
+
+	[[noreturn]] void run();
+
+	Stats getStats() const;
+	void resetStats();
+};
+
+#endif // _SCHEDULER_HPP__
@@ -0,0 +1,55 @@
+#ifndef _SEQLOCK_HPP__
+#define _SEQLOCK_HPP__
+
+// A value shared between the two cores, or a core and an interrupt, without locks.  One side
+// writes, any number read.  The writer never waits.  A reader copies the value and tries again if
+// the sequence number shows a write was in progress or happened meanwhile, so it always gets a
+// whole value, never half of an old one and half of a new one.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+template <typename T>
+class SeqLock {
+
+	static_assert(std::is_trivially_copyable_v<T>, "SeqLock copies T as bytes.");
+
+	std::atomic<uint32_t> sequence;		// Odd while a write is in progress.
+	T value;
+
+public:
+	SeqLock() : sequence(0), value() {}
+	explicit SeqLock(const T& initial) : sequence(0), value(initial) {}
+
+	// Only ever from one side.
+	void write(const T& newValue) {
+
+		auto s = sequence.load(std::memory_order_relaxed);
+		sequence.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(&value, &newValue, sizeof(T));
+		std::atomic_thread_fence(std::memory_order_release);
+		sequence.store(s + 2, std::memory_order_relaxed);
+	}
+
+	T read() const {
+
+		T copy;
+		uint32_t before, after;
+		do {
+			before = sequence.load(std::memory_order_acquire);
+			std::memcpy(&copy, &value, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = sequence.load(std::memory_order_relaxed);
+		} while ((before & 1) || before != after);
+		return copy;
+	}
+
+	// Changes with every write, so a reader can tell if there is anything new.
+	uint32_t version() const { return sequence.load(std::memory_order_acquire); }
+};
+
+#endif // _SEQLOCK_HPP__
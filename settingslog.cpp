@@ -0,0 +1,222 @@
+#include "settingslog.hpp"
+#include "crc.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+SettingsLog::SettingsLog(Entry* entries, uint count, uint64_t delayUs) :
+			entries(entries),
+			count(count < MAX_ENTRIES ? count : MAX_ENTRIES),
+			delayUs(delayUs),
+			stored(),
+			active(SECTORS - 1),
+			position(0),
+			fresh(true),
+			pending(false),
+			changedUs(0),
+			stats(),
+			page(),
+			pageOffset(0),
+			cursor(0),
+			pageOk(true) {}
+
+
+uint SettingsLog::load() {
+
+	auto flash = HAL::flashStore();
+	stored.fill(nullptr);
+	fresh = true;
+
+	// The newest sector whose snapshot finished.  Sequence numbers are compared as a difference,
+	// so they can wrap.
+	bool found = false;
+	for (uint32_t sector = 0; sector < SECTORS; ++sector) {
+		SectorHeader header;
+		std::memcpy(&header, flash + sector * HAL::FLASH_SECTOR_BYTES, sizeof(header));
+		if (header.magic != MAGIC) continue;
+		if (!found || static_cast<int32_t>(header.sequence - stats.sequence) > 0) {
+			active = sector;
+			stats.sequence = header.sequence;
+			found = true;
+		}
+	}
+	if (!found) return 0;
+
+	auto base = flash + active * HAL::FLASH_SECTOR_BYTES;
+	uint32_t at = sizeof(SectorHeader);
+	fresh = false;
+	while (at + sizeof(RecordHeader) <= HAL::FLASH_SECTOR_BYTES) {
+		RecordHeader header;
+		std::memcpy(&header, base + at, sizeof(header));
+		if (header.key == ERASED_KEY) break;
+
+		uint32_t size = recordBytes(header.bytes);
+		uint32_t crc;
+		if (static_cast<uint8_t>(~header.bytes) != header.check || at + size > HAL::FLASH_SECTOR_BYTES) {
+			fresh = true;
+			break;
+		}
+		std::memcpy(&crc, base + at + size - sizeof(crc), sizeof(crc));
+		if (CRC::crc32(base + at, sizeof(header) + header.bytes) != crc) {
+			fresh = true;
+			break;
+		}
+		for (uint i = 0; i < count; ++i) {
+			if (entries[i].key == header.key && entries[i].bytes == header.bytes) stored[i] = base + at + sizeof(header);
+		}
+		at += size;
+	}
+	position = at;
+	stats.used = at;
+
+	uint restored = 0;
+	for (uint i = 0; i < count; ++i) {
+		if (!stored[i]) continue;
+		std::memcpy(entries[i].value, stored[i], entries[i].bytes);
+		++restored;
+	}
+	stats.restored = restored;
+	return restored;
+}
+
+
+void SettingsLog::changed() {
+	pending = true;
+	changedUs = HAL::timeUs();
+}
+
+
+bool SettingsLog::service() {
+
+	if (!pending || HAL::timeUs() - changedUs < delayUs) return false;
+	return save();
+}
+
+
+bool SettingsLog::differs(uint i) const { return !stored[i] || std::memcmp(entries[i].value, stored[i], entries[i].bytes) != 0; }
+
+
+// Where each entry's value goes is only taken on once its write has succeeded, so after a failure
+// differs() still compares against what flash really holds, and the save is tried again.
+bool SettingsLog::save() {
+
+	pending = false;
+	uint32_t bytes = 0;
+	for (uint i = 0; i < count; ++i) {
+		if (differs(i)) bytes += recordBytes(entries[i].bytes);
+	}
+	if (!bytes) return true;
+	if (fresh || position + bytes > HAL::FLASH_SECTOR_BYTES) return compact();
+
+	auto written = stored;
+	beginWrite(active * HAL::FLASH_SECTOR_BYTES + position);
+	for (uint i = 0; i < count; ++i) {
+		if (differs(i)) written[i] = putRecord(i);
+	}
+	if (!endWrite()) {
+		fresh = true;
+		pending = true;
+		return false;
+	}
+
+	stored = written;
+	position += bytes;
+	stats.used = position;
+	++stats.saves;
+	return true;
+}
+
+
+// A snapshot of everything in the next sector round, and then its header.
+bool SettingsLog::compact() {
+
+	uint32_t next = (active + 1) % SECTORS;
+	uint32_t start = next * HAL::FLASH_SECTOR_BYTES;
+	fresh = true;
+	pending = true;
+	if (!HAL::flashErase(start)) {
+		++stats.failures;
+		return false;
+	}
+
+	auto written = stored;
+	uint32_t bytes = sizeof(SectorHeader);
+	beginWrite(start + bytes);
+	for (uint i = 0; i < count; ++i) {
+		if (bytes + recordBytes(entries[i].bytes) > HAL::FLASH_SECTOR_BYTES) break;
+		written[i] = putRecord(i);
+		bytes += recordBytes(entries[i].bytes);
+	}
+	if (!endWrite()) return false;
+
+	SectorHeader header { MAGIC, stats.sequence + 1 };
+	beginWrite(start);
+	put(&header, sizeof(header));
+	if (!endWrite()) return false;
+
+	stored = written;
+	active = next;
+	position = bytes;
+	fresh = false;
+	pending = false;
+	stats.sequence = header.sequence;
+	stats.used = bytes;
+	++stats.saves;
+	++stats.compactions;
+	return true;
+}
+
+
+// Returns where the value lands in flash.
+const uint8_t* SettingsLog::putRecord(uint i) {
+
+	auto& entry = entries[i];
+	RecordHeader header { entry.key, entry.bytes, static_cast<uint8_t>(~entry.bytes) };
+	uint32_t crc = CRC::crc32(&header, sizeof(header));
+	crc = CRC::crc32(entry.value, entry.bytes, crc);
+
+	put(&header, sizeof(header));
+	auto value = HAL::flashStore() + cursor;
+	put(entry.value, entry.bytes);
+	static constexpr uint8_t PADDING[3] { 0xFF, 0xFF, 0xFF };
+	put(PADDING, (4 - entry.bytes % 4) % 4);
+	put(&crc, sizeof(crc));
+	return value;
+}
+
+
+// Each page starts as what is in flash, so programming it back only changes the new bytes.
+void SettingsLog::beginWrite(uint32_t offset) {
+
+	cursor = offset;
+	pageOffset = offset - offset % HAL::FLASH_PAGE_BYTES;
+	std::memcpy(page.data(), HAL::flashStore() + pageOffset, page.size());
+	pageOk = true;
+}
+
+
+void SettingsLog::put(const void* data, uint32_t bytes) {
+
+	auto from = static_cast<const uint8_t*>(data);
+	while (bytes) {
+		if (cursor >= pageOffset + HAL::FLASH_PAGE_BYTES) {
+			pageOk &= HAL::flashProgram(pageOffset, page.data());
+			pageOffset += HAL::FLASH_PAGE_BYTES;
+			std::memcpy(page.data(), HAL::flashStore() + pageOffset, page.size());
+		}
+		uint32_t n = std::min(bytes, pageOffset + HAL::FLASH_PAGE_BYTES - cursor);
+		std::memcpy(&page[cursor - pageOffset], from, n);
+		from += n;
+		cursor += n;
+		bytes -= n;
+	}
+}
+
+
+bool SettingsLog::endWrite() {
+
+	pageOk &= HAL::flashProgram(pageOffset, page.data());
+	if (!pageOk) ++stats.failures;
+	return pageOk;
+}
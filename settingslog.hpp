@@ -0,0 +1,113 @@
+#ifndef _SETTINGSLOG_HPP__
+#define _SETTINGSLOG_HPP__
+
+// Settings kept over power cycles in HAL's flash store, as an append only log of key/value records.
+//
+// Each sector of the store starts with a snapshot of every entry and then takes changed entries on
+// the end until it is full.  The next sector round is then erased and gets a new snapshot, so the
+// sectors wear evenly and a sector is only erased once per sector of changes.  The sector's header,
+// with a sequence number, is programmed after its snapshot, so a snapshot cut short by a power
+// cut is never used and the previous sector still holds everything.
+//
+// Records are 4 byte aligned: a key, the value's length and its complement, the value, padding,
+// and a CRC-32 of the header and value.  Unwritten flash reads as key 0xFFFF.  At boot only the
+// newest sector is read, once, later records for a key replacing earlier ones.  A record that
+// fails its CRC ends the scan, and the next save goes to a fresh sector.  So after a power cut
+// each value is either the old or the new one, though a save cut short can keep some of each.
+//
+// Saves are deferred: changed() only notes the time, service() writes everything that differs
+// from flash once nothing has changed for a while, so a burst of changes is one write.  A save
+// the flash failed stays pending, to be tried again.
+
+#include "hal.hpp"
+
+#include <array>
+
+
+class SettingsLog {
+
+public:
+	// A value to keep, anything trivially copyable up to 255 bytes.  Keys are for good: a value
+	// whose layout changes needs a new key, or it is restored from the old one if its size matches.
+	struct Entry {
+		uint16_t key;		// Not 0xFFFF.
+		void* value;
+		uint8_t bytes;
+	};
+
+	static constexpr uint MAX_ENTRIES { 16 };
+	static constexpr uint32_t SECTORS { HAL::FLASH_STORE_BYTES / HAL::FLASH_SECTOR_BYTES };
+	static_assert(SECTORS >= 2, "A new snapshot can't overwrite the only one.");
+
+	struct Stats {
+		uint32_t sequence;		// Of the sector in use, one more each time it moves on.
+		uint32_t used;			// Bytes of it.
+		uint32_t saves;
+		uint32_t compactions;
+		uint32_t failures;		// Erases or programs that failed.
+		uint32_t restored;		// Entries load() found.
+	};
+
+private:
+	static constexpr uint32_t MAGIC { 0x54454353 };	// "TECS"
+	static constexpr uint16_t ERASED_KEY { 0xFFFF };
+
+	struct SectorHeader {
+		uint32_t magic;
+		uint32_t sequence;
+	};
+
+	struct RecordHeader {
+		uint16_t key;
+		uint8_t bytes;
+		uint8_t check;		// ~bytes
+	};
+
+	static constexpr uint32_t recordBytes(uint bytes) { return sizeof(RecordHeader) + ((bytes + 3) & ~3u) + sizeof(uint32_t); }
+
+	Entry* const entries;
+	const uint count;
+	const uint64_t delayUs;
+
+	std::array<const uint8_t*, MAX_ENTRIES> stored;		// Each entry's latest value in flash.
+	uint32_t active;			// Sector.
+	uint32_t position;			// Next free byte in it.
+	bool fresh;					// The next save needs a new sector.
+	bool pending;
+	uint64_t changedUs;
+	Stats stats;
+
+	// Appends go through one page in RAM, programmed when the writer moves off it.
+	std::array<uint8_t, HAL::FLASH_PAGE_BYTES> page;
+	uint32_t pageOffset;
+	uint32_t cursor;
+	bool pageOk;
+
+	void beginWrite(uint32_t offset);
+	void put(const void* data, uint32_t bytes);
+	bool endWrite();
+	const uint8_t* putRecord(uint i);
+
+	bool differs(uint i) const;
+	bool compact();
+
+public:
+	template <size_t N>
+	SettingsLog(Entry (&entries)[N], uint64_t delayUs) : SettingsLog(entries, N, delayUs) {
+		static_assert(N <= MAX_ENTRIES, "Too many entries.");
+	}
+	SettingsLog(Entry* entries, uint count, uint64_t delayUs);
+
+	// Overwrites the entries with what is in flash.  Once, at boot, before anything uses them.
+	// Returns how many were found.
+	uint load();
+
+	void changed();		// Something may differ from flash now.
+	bool service();		// From the main loop.  True if it saved.
+	bool save();		// Whatever differs, now.  False if the flash failed, and it's still pending.
+	bool isPending() const { return pending; }
+
+	const Stats& getStats() const { return stats; }
+};
+
+#endif // _SETTINGSLOG_HPP__
@@ -0,0 +1,75 @@
+#include "telemetry.hpp"
+#include "crc.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+Telemetry::Telemetry() : ring(), head(0), tail(0), inFlight(0), frames(0), dropped(0), sentBytes(0) {}
+
+
+void Telemetry::init(uint txPin, uint32_t baud) { HAL::uartInit(txPin, baud); }
+
+
+bool Telemetry::push(const Sample& sample) {
+
+	auto h = head.load(std::memory_order_relaxed);
+	if (RING_BYTES - (h - tail.load(std::memory_order_acquire)) < MAX_ENCODED) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	uint8_t frame[FRAME_BYTES];
+	frame[0] = SAMPLE_FRAME;
+	std::memcpy(&frame[1], &sample, sizeof(sample));
+	uint32_t crc = CRC::crc32(frame, 1 + sizeof(sample));
+	std::memcpy(&frame[1 + sizeof(sample)], &crc, sizeof(crc));
+
+	struct RingAt {
+		uint8_t* ring;
+		uint32_t start;
+		uint8_t& operator[](size_t i) { return ring[(start + i) & (RING_BYTES - 1)]; }
+	} out { ring.data(), h };
+	size_t n = COBS::encode(frame, sizeof(frame), out);
+	out[n++] = 0;
+
+	head.store(h + n, std::memory_order_release);
+	frames.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+
+// From tail to the newest frame, or to the end of the ring if it wraps first.
+void Telemetry::send() {
+
+	if (inFlight) return;
+	auto t = tail.load(std::memory_order_relaxed);
+	auto available = head.load(std::memory_order_acquire) - t;
+	if (!available) return;
+	uint32_t index = t & (RING_BYTES - 1);
+	inFlight = std::min(available, RING_BYTES - index);
+	HAL::uartWriteAsync(&ring[index], inFlight, sent, this);
+}
+
+
+void Telemetry::sent(void* context) {
+
+	auto telemetry = static_cast<Telemetry*>(context);
+	telemetry->sentBytes += telemetry->inFlight;
+	telemetry->tail.store(telemetry->tail.load(std::memory_order_relaxed) + telemetry->inFlight, std::memory_order_release);
+	telemetry->inFlight = 0;
+	telemetry->send();
+}
+
+
+void Telemetry::service() {
+
+	auto state = HAL::disableInterrupts();
+	send();
+	HAL::restoreInterrupts(state);
+}
+
+
+Telemetry::Stats Telemetry::getStats() const {
+	return Stats { frames.load(std::memory_order_relaxed), dropped.load(std::memory_order_relaxed), sentBytes };
+}
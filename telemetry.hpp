@@ -0,0 +1,75 @@
+#ifndef _TELEMETRY_HPP__
+#define _TELEMETRY_HPP__
+
+// Binary telemetry on its own UART, a frame every control tick.
+//
+// The control core encodes each frame straight into a byte ring and the UART's DMA sends it from
+// there, so nothing is copied after encoding and the control core never waits on serial I/O: if the
+// ring is full the frame is dropped and counted.  Sending is chained from the DMA's completion
+// interrupt on core 0, and service() from the main loop restarts it once the ring has run dry.
+//
+// A frame is COBS encoded and ends in a zero byte.  Decoded it is a type byte, the payload and a
+// CRC-32 of both, all little endian.  host/decoder.cpp reads it.
+
+#include "hal.hpp"
+#include "cobs.hpp"
+
+#include <array>
+#include <atomic>
+
+
+class Telemetry {
+
+public:
+	static constexpr uint8_t SAMPLE_FRAME { 1 };
+
+	// One control tick.
+	struct Sample {
+		uint32_t tick;			// Gaps are dropped frames.
+		uint32_t timeUs;		// Low 32 bits.
+		int32_t temperature;	// Milli degrees C.
+		int32_t setpoint;
+		int16_t duty;			// Q15.
+		int16_t currentMa;
+		uint16_t execUs;
+		uint16_t lateUs;
+	};
+	static_assert(sizeof(Sample) == 24, "Sample is sent as it is, with no padding.");
+
+	static constexpr uint32_t FRAME_BYTES { 1 + sizeof(Sample) + sizeof(uint32_t) };
+	static constexpr uint32_t MAX_ENCODED { COBS::maxEncoded(FRAME_BYTES) + 1 };
+	static constexpr uint32_t RING_BYTES { 4096 };		// About 130 frames.
+	static_assert((RING_BYTES & (RING_BYTES - 1)) == 0, "The ring is indexed by masking.");
+
+	struct Stats {
+		uint32_t frames;
+		uint32_t dropped;
+		uint32_t bytes;			// Sent.
+	};
+
+private:
+	std::array<uint8_t, RING_BYTES> ring;
+	std::atomic<uint32_t> head;		// Free running.  Only the producer writes it.
+	std::atomic<uint32_t> tail;		// Only the sender writes it.
+	uint32_t inFlight;				// Bytes the DMA has, from tail.
+	std::atomic<uint32_t> frames;
+	std::atomic<uint32_t> dropped;
+	uint32_t sentBytes;
+
+	static void sent(void* context);
+	void send();		// With interrupts off, or from the completion interrupt.
+
+public:
+	Telemetry();
+
+	void init(uint txPin, uint32_t baud);
+
+	// The control core.  False if it was dropped.
+	bool push(const Sample& sample);
+
+	// Core 0.
+	void service();
+	Stats getStats() const;
+};
+
+#endif // _TELEMETRY_HPP__
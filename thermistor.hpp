@@ -0,0 +1,124 @@
+#ifndef _THERMISTOR_HPP__
+#define _THERMISTOR_HPP__
+
+// NTC thermistor to temperature without floating point at run time.  The curve, from either the
+// B parameter or Steinhart-Hart coefficients, is worked out by the compiler into a table that
+// lives in flash, and a reading is one table lookup and a linear interpolation in integers.
+//
+// The thermistor goes from the ADC input to ground, seriesOhms from the input to the ADC's
+// reference, so the reading is the fraction R / (R + seriesOhms) of full scale.
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <sys/types.h>
+
+
+namespace Thermistor {
+
+	inline constexpr double KELVIN { 273.15 };
+	inline constexpr double LN2 { 0.693147180559945309417 };
+
+	// std::log isn't constexpr.  x = m * 2^k with m in [0.75, 1.5), where the atanh series for
+	// ln m converges in a few terms.
+	constexpr double ln(double x) {
+
+		int k = 0;
+		while (x >= 1.5) { x /= 2; ++k; }
+		while (x < 0.75) { x *= 2; --k; }
+		double y = (x - 1) / (x + 1);
+		double term = y;
+		double sum = 0;
+		for (int n = 1; n < 40; n += 2) {
+			sum += term / n;
+			term *= y * y;
+		}
+		return 2 * sum + k * LN2;
+	}
+
+
+	struct Beta {
+		double r0Ohms;		// At t0C.
+		double t0C;
+		double beta;
+	};
+
+	// 1 / T = a + b ln R + c (ln R)^3, T in kelvin.
+	struct SteinhartHart {
+		double a;
+		double b;
+		double c;
+	};
+
+	constexpr double kelvin(const Beta& m, double ohms) { return 1 / (1 / (m.t0C + KELVIN) + ln(ohms / m.r0Ohms) / m.beta); }
+
+	constexpr double kelvin(const SteinhartHart& m, double ohms) {
+		double l = ln(ohms);
+		return 1 / (m.a + m.b * l + m.c * l * l * l);
+	}
+
+	// The other way, for checking and for the simulation.  Not for the firmware.
+	inline double ohms(const Beta& m, double kelvin) { return m.r0Ohms * std::exp(m.beta * (1 / kelvin - 1 / (m.t0C + KELVIN))); }
+
+	inline double ohms(const SteinhartHart& m, double kelvin) {
+		double x = (m.a - 1 / kelvin) / m.c;
+		double y = std::sqrt(std::pow(m.b / (3 * m.c), 3) + x * x / 4);
+		return std::exp(std::cbrt(y - x / 2) - std::cbrt(y + x / 2));
+	}
+
+
+	template <typename Model>
+	struct Circuit {
+		Model model;
+		double seriesOhms;
+		double minC;		// Readings are clamped to these, which also covers open and short.
+		double maxC;
+	};
+
+
+	// Readings are INPUT_BITS wide, the ADC's 12 bits and any fraction bits a filter added.  There
+	// is a point every 2^SEGMENT_BITS of input.
+	template <const auto& CIRCUIT, uint INPUT_BITS = 16, uint SEGMENT_BITS = 8>
+	class Table {
+
+		static_assert(SEGMENT_BITS < INPUT_BITS, "Need at least two segments.");
+		static_assert(SEGMENT_BITS <= 12, "The interpolation would overflow 32 bits.");
+
+	public:
+		static constexpr uint POINTS { (1u << (INPUT_BITS - SEGMENT_BITS)) + 1 };
+
+		// Milli degrees C at the fraction of full scale.  Exact, but doubles.
+		static constexpr int32_t reference(double fraction) {
+
+			double c = fraction <= 0 ? CIRCUIT.maxC
+					 : fraction >= 1 ? CIRCUIT.minC
+					 : kelvin(CIRCUIT.model, CIRCUIT.seriesOhms * fraction / (1 - fraction)) - KELVIN;
+			c = c < CIRCUIT.minC ? CIRCUIT.minC : c > CIRCUIT.maxC ? CIRCUIT.maxC : c;
+			return static_cast<int32_t>(c * 1000 + (c < 0 ? -0.5 : 0.5));
+		}
+
+	private:
+		static constexpr std::array<int32_t, POINTS> build() {
+
+			std::array<int32_t, POINTS> points {};
+			for (uint i = 0; i < POINTS; ++i) {
+				points[i] = reference(static_cast<double>(i << SEGMENT_BITS) / (1u << INPUT_BITS));
+			}
+			return points;
+		}
+
+		static constexpr std::array<int32_t, POINTS> points { build() };
+
+	public:
+		static constexpr int32_t milliC(uint32_t reading) {
+
+			if (reading >= (1u << INPUT_BITS)) reading = (1u << INPUT_BITS) - 1;
+			uint i = reading >> SEGMENT_BITS;
+			int32_t fraction = reading & ((1u << SEGMENT_BITS) - 1);
+			int32_t low = points[i];
+			return low + (((points[i + 1] - low) * fraction) >> SEGMENT_BITS);
+		}
+	};
+}
+
+#endif // _THERMISTOR_HPP__